@@ -0,0 +1,502 @@
+#include "libbinary.h"
+#include "libxml.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using std::map;
+using std::string;
+using std::tuple;
+using std::vector;
+
+namespace bin = serializer::binary;
+namespace xml = serializer::xml;
+
+// A user-defined type that can go through every path.
+struct Record : bin::BinSerializable, xml::XMLSerializable {
+  int id = 0;
+  string name;
+  vector<double> values;
+
+  string serializeToString() const override {
+    std::stringstream ss;
+    bin::serialize(id, ss);
+    bin::serialize(name, ss);
+    bin::serialize(values, ss);
+    return ss.str();
+  }
+  void deserializeFromString(const string &s) override {
+    std::stringstream ss(s);
+    bin::deserialize(id, ss);
+    bin::deserialize(name, ss);
+    bin::deserialize(values, ss);
+  }
+  vector<string> serializeToXML() const override {
+    return {xml::serialize_to_string_xml(id, "id"), xml::serialize_to_string_xml(name, "name"),
+            xml::serialize_to_string_xml(values, "values")};
+  }
+  void deserializeFromXML(const vector<string> &v) override {
+    xml::deserialize_from_string_xml(id, "id", v[0]);
+    xml::deserialize_from_string_xml(name, "name", v[1]);
+    xml::deserialize_from_string_xml(values, "values", v[2]);
+  }
+};
+
+struct Options {
+  vector<size_t> sizes = {1 << 10, 64 << 10};
+  vector<string> paths = {"binary", "xml", "xml_b64"};
+  string filter;
+  double min_seconds = 0.2;
+  size_t min_iterations = 3;
+  size_t max_iterations = 100000;
+  string out = "bench_result.json";
+  string baseline;
+  double threshold = 0.10;
+};
+
+struct Result {
+  string name;
+  string path;
+  string dataset;
+  size_t target_bytes;
+  size_t encoded_bytes;
+  size_t iterations;
+  double encode_mbps;
+  double decode_mbps;
+  double encode_ops;
+  double decode_ops;
+  double encode_p50_us, encode_p90_us, encode_p99_us;
+  double decode_p50_us, decode_p90_us, decode_p99_us;
+  long peak_rss_kb;
+};
+
+static size_t parse_size(const string &s) {
+  size_t pos = 0;
+  double v = std::stod(s, &pos);
+  if (pos < s.size()) {
+    switch (s[pos]) {
+    case 'K':
+    case 'k':
+      v *= 1 << 10;
+      break;
+    case 'M':
+    case 'm':
+      v *= 1 << 20;
+      break;
+    case 'G':
+    case 'g':
+      v *= 1 << 30;
+      break;
+    default:
+      throw std::runtime_error("bad size: " + s);
+    }
+  }
+  return static_cast<size_t>(v);
+}
+
+static vector<string> split(const string &s, char sep) {
+  vector<string> result;
+  std::stringstream ss(s);
+  string item;
+  while (std::getline(ss, item, sep)) {
+    if (!item.empty()) {
+      result.push_back(item);
+    }
+  }
+  return result;
+}
+
+// Datasets. Each generator produces roughly `bytes` bytes of binary-encoded payload.
+namespace datasets {
+  static std::mt19937_64 rng(42);
+
+  static string random_string(size_t len) {
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+    string s(len, ' ');
+    for (auto &c : s) {
+      c = alphabet[rng() % (sizeof(alphabet) - 1)];
+    }
+    return s;
+  }
+
+  // One element of a vector<double> costs a size prefix plus the value itself.
+  static vector<double> doubles(size_t bytes) {
+    vector<double> v(std::max<size_t>(1, bytes / 16));
+    std::uniform_real_distribution<double> dist(-1e6, 1e6);
+    for (auto &d : v) {
+      d = dist(rng);
+    }
+    return v;
+  }
+  static vector<string> strings(size_t bytes) {
+    vector<string> v(std::max<size_t>(1, bytes / 32));
+    for (auto &s : v) {
+      s = random_string(8 + rng() % 17);
+    }
+    return v;
+  }
+  static map<string, map<int, double>> nested_maps(size_t bytes) {
+    map<string, map<int, double>> m;
+    const size_t inner = 16;
+    const size_t outer = std::max<size_t>(1, bytes / (inner * 32 + 32));
+    for (size_t i = 0; i < outer; i++) {
+      auto &in = m[random_string(12) + std::to_string(i)];
+      for (size_t j = 0; j < inner; j++) {
+        in[static_cast<int>(j)] = static_cast<double>(rng() % 100000) / 7;
+      }
+    }
+    return m;
+  }
+  static vector<tuple<int, double, string>> tuples(size_t bytes) {
+    vector<tuple<int, double, string>> v(std::max<size_t>(1, bytes / 56));
+    for (auto &t : v) {
+      t = {static_cast<int>(rng()), static_cast<double>(rng() % 1000) / 3, random_string(12)};
+    }
+    return v;
+  }
+  static vector<Record> records(size_t bytes) {
+    vector<Record> v(std::max<size_t>(1, bytes / 256));
+    for (auto &r : v) {
+      r.id = static_cast<int>(rng());
+      r.name = random_string(16);
+      r.values = doubles(160);
+    }
+    return v;
+  }
+} // namespace datasets
+
+static double percentile_us(vector<double> v, double p) {
+  std::sort(v.begin(), v.end());
+  size_t idx = std::min(v.size() - 1, static_cast<size_t>(p * (v.size() - 1) + 0.5));
+  return v[idx] * 1e6;
+}
+
+// Runs `f` until both min_seconds and min_iterations are reached, returning per-call seconds.
+static vector<double> measure(const Options &opt, const std::function<void()> &f) {
+  vector<double> samples;
+  double total = 0;
+  while ((total < opt.min_seconds || samples.size() < opt.min_iterations) && samples.size() < opt.max_iterations) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    samples.push_back(s);
+    total += s;
+  }
+  return samples;
+}
+
+template <typename T>
+static Result run_case(const Options &opt, const string &path, const string &dataset, size_t target, const T &value) {
+  string encoded;
+  std::function<void()> encode, decode;
+  if (path == "binary") {
+    encode = [&] {
+      std::ostringstream os;
+      bin::serialize(value, os);
+      encoded = os.str();
+    };
+    decode = [&] {
+      std::istringstream is(encoded);
+      T out{};
+      bin::deserialize(out, is);
+    };
+  } else if (path == "xml") {
+    encode = [&] { encoded = xml::serialize_to_string_xml(value, "bench"); };
+    decode = [&] {
+      T out{};
+      xml::deserialize_from_string_xml(out, "bench", encoded);
+    };
+  } else if (path == "xml_b64") {
+    encode = [&] { encoded = base64_encode_pem(xml::serialize_to_string_xml(value, "bench")); };
+    decode = [&] {
+      T out{};
+      xml::deserialize_from_string_xml(out, "bench", base64_decode(encoded, true));
+    };
+  } else {
+    throw std::runtime_error("unknown path: " + path);
+  }
+
+  vector<double> enc = measure(opt, encode);
+  vector<double> dec = measure(opt, decode);
+  double enc_total = 0, dec_total = 0;
+  for (double s : enc) {
+    enc_total += s;
+  }
+  for (double s : dec) {
+    dec_total += s;
+  }
+  const double mb = static_cast<double>(encoded.size()) / (1 << 20);
+  Result r;
+  r.path = path;
+  r.dataset = dataset;
+  r.target_bytes = target;
+  r.name = path + "/" + dataset + "/" + std::to_string(target);
+  r.encoded_bytes = encoded.size();
+  r.iterations = std::min(enc.size(), dec.size());
+  r.encode_ops = enc.size() / enc_total;
+  r.decode_ops = dec.size() / dec_total;
+  r.encode_mbps = mb * r.encode_ops;
+  r.decode_mbps = mb * r.decode_ops;
+  r.encode_p50_us = percentile_us(enc, 0.50);
+  r.encode_p90_us = percentile_us(enc, 0.90);
+  r.encode_p99_us = percentile_us(enc, 0.99);
+  r.decode_p50_us = percentile_us(dec, 0.50);
+  r.decode_p90_us = percentile_us(dec, 0.90);
+  r.decode_p99_us = percentile_us(dec, 0.99);
+  r.peak_rss_kb = 0;
+  return r;
+}
+
+static void write_result(const Result &r, std::ostream &os) {
+  os << "{\"name\": \"" << r.name << "\", \"path\": \"" << r.path << "\", \"dataset\": \"" << r.dataset
+       << "\", \"target_bytes\": " << r.target_bytes << ", \"encoded_bytes\": " << r.encoded_bytes
+       << ", \"iterations\": " << r.iterations << ", \"encode_mbps\": " << r.encode_mbps
+       << ", \"decode_mbps\": " << r.decode_mbps << ", \"encode_ops\": " << r.encode_ops
+       << ", \"decode_ops\": " << r.decode_ops << ", \"encode_p50_us\": " << r.encode_p50_us
+       << ", \"encode_p90_us\": " << r.encode_p90_us << ", \"encode_p99_us\": " << r.encode_p99_us
+       << ", \"decode_p50_us\": " << r.decode_p50_us << ", \"decode_p90_us\": " << r.decode_p90_us
+       << ", \"decode_p99_us\": " << r.decode_p99_us << ", \"peak_rss_kb\": " << r.peak_rss_kb << "}";
+}
+
+static void write_json(const vector<Result> &results, std::ostream &os) {
+  // One result per line, so that read_baseline() below doesn't need a real JSON parser.
+  os << std::setprecision(6) << "{\n  \"results\": [\n";
+  for (size_t i = 0; i < results.size(); i++) {
+    os << "    ";
+    write_result(results[i], os);
+    os << (i + 1 < results.size() ? "," : "") << "\n";
+  }
+  os << "  ]\n}\n";
+}
+
+static double json_number(const string &line, const string &key) {
+  const string needle = "\"" + key + "\": ";
+  size_t pos = line.find(needle);
+  return pos == string::npos ? 0 : std::stod(line.substr(pos + needle.size()));
+}
+static string json_string(const string &line, const string &key) {
+  const string needle = "\"" + key + "\": \"";
+  size_t pos = line.find(needle);
+  if (pos == string::npos) {
+    return string();
+  }
+  pos += needle.size();
+  return line.substr(pos, line.find('"', pos) - pos);
+}
+
+// the inverse of write_result
+static Result parse_result(const string &line) {
+  Result r;
+  r.name = json_string(line, "name");
+  r.path = json_string(line, "path");
+  r.dataset = json_string(line, "dataset");
+  r.target_bytes = json_number(line, "target_bytes");
+  r.encoded_bytes = json_number(line, "encoded_bytes");
+  r.iterations = json_number(line, "iterations");
+  r.encode_mbps = json_number(line, "encode_mbps");
+  r.decode_mbps = json_number(line, "decode_mbps");
+  r.encode_ops = json_number(line, "encode_ops");
+  r.decode_ops = json_number(line, "decode_ops");
+  r.encode_p50_us = json_number(line, "encode_p50_us");
+  r.encode_p90_us = json_number(line, "encode_p90_us");
+  r.encode_p99_us = json_number(line, "encode_p99_us");
+  r.decode_p50_us = json_number(line, "decode_p50_us");
+  r.decode_p90_us = json_number(line, "decode_p90_us");
+  r.decode_p99_us = json_number(line, "decode_p99_us");
+  r.peak_rss_kb = json_number(line, "peak_rss_kb");
+  return r;
+}
+
+// Runs one case, including building its dataset, in a forked child. ru_maxrss is a high-water
+// mark that never goes down, so measuring every case in one process would report the largest case
+// so far; the child's own peak RSS belongs to this case alone (plus the small footprint it
+// inherits).
+static Result run_isolated(const std::function<Result()> &run) {
+  int fds[2];
+  ASSERT(pipe(fds) == 0);
+  std::cout.flush();
+  const pid_t pid = fork();
+  ASSERT(pid >= 0);
+  if (pid == 0) {
+    close(fds[0]);
+    std::ostringstream os;
+    os << std::setprecision(17);
+    write_result(run(), os);
+    const string line = os.str();
+    size_t written = 0;
+    while (written < line.size()) {
+      const ssize_t n = write(fds[1], line.data() + written, line.size() - written);
+      if (n <= 0) {
+        _exit(1);
+      }
+      written += n;
+    }
+    _exit(0);
+  }
+  close(fds[1]);
+  string line;
+  char buf[4096];
+  ssize_t n;
+  while ((n = read(fds[0], buf, sizeof(buf))) > 0) {
+    line.append(buf, n);
+  }
+  close(fds[0]);
+  int status;
+  rusage usage;
+  ASSERT(wait4(pid, &status, 0, &usage) == pid);
+  ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  Result r = parse_result(line);
+  r.peak_rss_kb = usage.ru_maxrss;
+  return r;
+}
+
+// name -> (encode_mbps, decode_mbps)
+static map<string, std::pair<double, double>> read_baseline(const string &file_name) {
+  map<string, std::pair<double, double>> baseline;
+  std::ifstream is(file_name);
+  ASSERT(is.good());
+  string line;
+  while (std::getline(is, line)) {
+    size_t pos = line.find("\"name\": \"");
+    if (pos == string::npos) {
+      continue;
+    }
+    pos += 9;
+    const string name = line.substr(pos, line.find('"', pos) - pos);
+    baseline[name] = {json_number(line, "encode_mbps"), json_number(line, "decode_mbps")};
+  }
+  return baseline;
+}
+
+static void usage() {
+  std::cout << "usage: bench_serializer [options]\n"
+               "  --sizes 1K,64K        payload sizes (K/M/G suffixes), up to several GB\n"
+               "  --paths binary,xml,xml_b64\n"
+               "  --filter <substring>  only run cases whose name contains this\n"
+               "  --min-time <seconds>  minimum measuring time per direction (default 0.2)\n"
+               "  --out <file>          JSON results (default bench_result.json)\n"
+               "  --baseline <file>     compare against a previous JSON result\n"
+               "  --threshold <ratio>   allowed slowdown before flagging a regression (default 0.10)\n";
+}
+
+int main(int argc, char **argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    const string arg = argv[i];
+    auto next = [&]() -> string {
+      if (i + 1 >= argc) {
+        usage();
+        std::exit(2);
+      }
+      return argv[++i];
+    };
+    if (arg == "--sizes") {
+      opt.sizes.clear();
+      for (const string &s : split(next(), ',')) {
+        opt.sizes.push_back(parse_size(s));
+      }
+    } else if (arg == "--paths") {
+      opt.paths = split(next(), ',');
+    } else if (arg == "--filter") {
+      opt.filter = next();
+    } else if (arg == "--min-time") {
+      opt.min_seconds = std::stod(next());
+    } else if (arg == "--out") {
+      opt.out = next();
+    } else if (arg == "--baseline") {
+      opt.baseline = next();
+    } else if (arg == "--threshold") {
+      opt.threshold = std::stod(next());
+    } else {
+      usage();
+      return arg == "--help" ? 0 : 2;
+    }
+  }
+
+  vector<Result> results;
+  auto selected = [&](const string &path, const string &dataset, size_t size) {
+    const string name = path + "/" + dataset + "/" + std::to_string(size);
+    return opt.filter.empty() || name.find(opt.filter) != string::npos;
+  };
+  auto report = [&](const Result &r) {
+    std::cout << std::left << std::setw(40) << r.name << std::right << std::fixed << std::setprecision(1)
+              << " enc " << std::setw(9) << r.encode_mbps << " MB/s " << std::setw(11) << r.encode_ops << " op/s"
+              << " | dec " << std::setw(9) << r.decode_mbps << " MB/s " << std::setw(11) << r.decode_ops << " op/s"
+              << " | rss " << r.peak_rss_kb / 1024 << " MB" << std::endl;
+    results.push_back(r);
+  };
+
+  for (const string &path : opt.paths) {
+    // Scalars don't scale with size, so they are only measured once per path.
+    if (selected(path, "scalar", 8)) {
+      report(run_isolated([&] { return run_case(opt, path, "scalar", 8, 3.14159265358979); }));
+    }
+    for (size_t size : opt.sizes) {
+      if (selected(path, "vector_double", size)) {
+        report(run_isolated([&] { return run_case(opt, path, "vector_double", size, datasets::doubles(size)); }));
+      }
+      if (selected(path, "vector_string", size)) {
+        report(run_isolated([&] { return run_case(opt, path, "vector_string", size, datasets::strings(size)); }));
+      }
+      if (selected(path, "nested_map", size)) {
+        report(run_isolated([&] { return run_case(opt, path, "nested_map", size, datasets::nested_maps(size)); }));
+      }
+      if (selected(path, "vector_tuple", size)) {
+        report(run_isolated([&] { return run_case(opt, path, "vector_tuple", size, datasets::tuples(size)); }));
+      }
+      if (selected(path, "user_type", size)) {
+        report(run_isolated([&] { return run_case(opt, path, "user_type", size, datasets::records(size)); }));
+      }
+    }
+  }
+
+  std::ofstream os(opt.out);
+  ASSERT(os.good());
+  write_json(results, os);
+  os.close();
+  std::cout << "[bench] results written to " << opt.out << std::endl;
+
+  if (opt.baseline.empty()) {
+    return 0;
+  }
+  int regressions = 0;
+  const auto baseline = read_baseline(opt.baseline);
+  for (const Result &r : results) {
+    auto it = baseline.find(r.name);
+    if (it == baseline.end()) {
+      continue;
+    }
+    const auto [enc, dec] = it->second;
+    if (r.encode_mbps < enc * (1 - opt.threshold)) {
+      regressions++;
+      std::cout << "[bench] REGRESSION " << r.name << " encode: " << r.encode_mbps << " MB/s < baseline " << enc
+                << " MB/s" << std::endl;
+    }
+    if (r.decode_mbps < dec * (1 - opt.threshold)) {
+      regressions++;
+      std::cout << "[bench] REGRESSION " << r.name << " decode: " << r.decode_mbps << " MB/s < baseline " << dec
+                << " MB/s" << std::endl;
+    }
+  }
+  if (regressions > 0) {
+    std::cout << "[bench] " << regressions << " regressions against " << opt.baseline << std::endl;
+    return 1;
+  }
+  std::cout << "[bench] no regressions against " << opt.baseline << std::endl;
+  return 0;
+}
@@ -4,6 +4,8 @@ clean_generated_files() {
   rm -rf ./result/*.bin
   rm -rf ./result/*.xml
   rm -rf ./result/*.b64
+  rm -rf ./result/sharded*
+  rm -rf ./result/checkpoint*
 }
 
 cd "$(dirname "$0")"/tests && clean_generated_files
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "libbinary.h"
+#include "mpsc_queue.h"
+
+namespace serializer {
+  namespace binary {
+    // Writes files on a dedicated background thread, so that the threads producing the data do not
+    // block on disk I/O.
+    //
+    // Any thread may submit work. Objects are encoded with serialize on the writer thread, and
+    // pre-encoded buffers are written as they are. Submissions go through a bounded lock-free queue:
+    // when it is full, save and write wait for room, while try_save and try_write give up. The
+    // writer drains up to max_batch jobs at a time, writes them in submission order, and then calls
+    // their callbacks on the writer thread.
+    class AsyncWriter {
+    public:
+      // Called once a job is done. ok is false if the object could not be encoded, or the file
+      // could not be written. Exceptions thrown by the callback are ignored.
+      using Callback = std::function<void(const string &file_name, bool ok)>;
+
+      explicit AsyncWriter(size_t capacity = 1024, size_t max_batch = 64)
+          : queue_(capacity), max_batch_(max_batch == 0 ? 1 : max_batch), writer_([this] { run(); }) {}
+      // Writes everything submitted so far, then stops the writer thread.
+      ~AsyncWriter() {
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          stopping_ = true;
+        }
+        wake_cv_.notify_one();
+        writer_.join();
+      }
+      AsyncWriter(const AsyncWriter &) = delete;
+      AsyncWriter &operator=(const AsyncWriter &) = delete;
+
+      // Writes `bytes` to `file_name`.
+      void write(string file_name, string bytes, Callback done = nullptr) {
+        Job job{std::move(file_name), std::move(bytes), nullptr, std::move(done)};
+        push(job);
+      }
+      bool try_write(string file_name, string bytes, Callback done = nullptr) {
+        Job job{std::move(file_name), std::move(bytes), nullptr, std::move(done)};
+        return try_push(job);
+      }
+      // Serializes t into `file_name`. t is moved (or copied) into the job, and encoded on the
+      // writer thread.
+      template <typename T>
+      void save(string file_name, T t, Callback done = nullptr) {
+        Job job{std::move(file_name), string(), encoder(std::move(t)), std::move(done)};
+        push(job);
+      }
+      template <typename T>
+      bool try_save(string file_name, T t, Callback done = nullptr) {
+        Job job{std::move(file_name), string(), encoder(std::move(t)), std::move(done)};
+        return try_push(job);
+      }
+
+      // Blocks until every job submitted before the call is written, and its callback has returned.
+      void flush() {
+        // Jobs are written in the order they claimed their slots in the queue, so once this many
+        // are complete, so is every job submitted before.
+        const size_t target = queue_.pushed();
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cv_.wait(lock, [&] { return completed_ >= target; });
+      }
+
+    private:
+      struct Job {
+        string file_name;
+        string bytes;
+        // Encodes the object of a save job, or is empty for write jobs.
+        std::function<string()> encode;
+        Callback done;
+      };
+
+      template <typename T>
+      static std::function<string()> encoder(T t) {
+        // std::function needs a copyable target, so the object is held through a shared_ptr.
+        auto object = std::make_shared<T>(std::move(t));
+        return [object]() {
+          std::ostringstream os;
+          serialize(*object, os);
+          return os.str();
+        };
+      }
+
+      bool try_push(Job &job) {
+        if (!queue_.try_push(job)) {
+          return false;
+        }
+        submitted_++;
+        wake();
+        return true;
+      }
+      // Back-pressure: wait for the writer to make room.
+      void push(Job &job) {
+        if (try_push(job)) {
+          return;
+        }
+        {
+          // The writer notifies room_cv_ under room_mutex_ after every batch it pops, so a failed
+          // attempt here is always followed by a notification.
+          std::unique_lock<std::mutex> lock(room_mutex_);
+          room_cv_.wait(lock, [&] { return queue_.try_push(job); });
+        }
+        submitted_++;
+        wake();
+      }
+      void wake() {
+        // Pairs with the check in run(): either the writer sees the new job before it sleeps, or
+        // this sees that it sleeps.
+        if (sleeping_.load()) {
+          std::lock_guard<std::mutex> lock(mutex_);
+          wake_cv_.notify_one();
+        }
+      }
+
+      void run() {
+        std::vector<Job> batch;
+        batch.reserve(max_batch_);
+        for (;;) {
+          Job job;
+          while (batch.size() < max_batch_ && queue_.try_pop(job)) {
+            batch.push_back(std::move(job));
+          }
+          if (batch.empty()) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            sleeping_.store(true);
+            wake_cv_.wait(lock, [&] { return stopping_ || submitted_.load() != popped_; });
+            sleeping_.store(false);
+            if (stopping_ && submitted_.load() == popped_) {
+              return;
+            }
+            continue;
+          }
+          popped_ += batch.size();
+          {
+            std::lock_guard<std::mutex> lock(room_mutex_);
+          }
+          room_cv_.notify_all();
+          std::vector<bool> ok(batch.size());
+          for (size_t i = 0; i < batch.size(); i++) {
+            ok[i] = write_file(batch[i]);
+          }
+          for (size_t i = 0; i < batch.size(); i++) {
+            if (batch[i].done) {
+              // There is nobody to report a failing callback to, and it must not stop the writer.
+              try {
+                batch[i].done(batch[i].file_name, ok[i]);
+              } catch (...) {
+              }
+            }
+          }
+          {
+            std::lock_guard<std::mutex> lock(mutex_);
+            completed_ += batch.size();
+          }
+          done_cv_.notify_all();
+          batch.clear();
+        }
+      }
+
+      static bool write_file(Job &job) {
+        // Encoding runs user code, and may run out of memory, on the writer thread.
+        try {
+          if (job.encode) {
+            job.bytes = job.encode();
+          }
+          std::ofstream os(job.file_name, std::ios::binary);
+          os.write(job.bytes.data(), job.bytes.size());
+          os.close();
+          return !os.fail();
+        } catch (...) {
+          return false;
+        }
+      }
+
+      BoundedMPSCQueue<Job> queue_;
+      const size_t max_batch_;
+      // Counts the jobs in the queue, for waking up the writer.
+      std::atomic<size_t> submitted_{0};
+      // only touched by the writer thread
+      size_t popped_ = 0;
+      std::mutex mutex_;
+      std::condition_variable wake_cv_;
+      std::condition_variable done_cv_;
+      // for producers waiting on a full queue
+      std::mutex room_mutex_;
+      std::condition_variable room_cv_;
+      std::atomic<bool> sleeping_{false};
+      bool stopping_ = false;
+      size_t completed_ = 0;
+      // Declared last, so that it starts once everything above is initialized.
+      std::thread writer_;
+    };
+  } // namespace binary
+} // namespace serializer
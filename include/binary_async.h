@@ -0,0 +1,55 @@
+#pragma once
+
+#include <functional>
+#include <future>
+#include <string>
+#include <utility>
+
+#include "errors.h"
+#include "libbinary.h"
+#include "thread_pool.h"
+
+// Asynchronous variants of the binary entry points, running on serializer::thread_pool().
+//
+// The object passed in is used by reference: it must stay alive, and must not be touched by the
+// caller, until the future is ready or the callback has been called.
+
+namespace serializer {
+  namespace binary {
+    // declarations
+    template <typename T>
+    std::future<void> serialize_async(const T &t, string file_name);
+    // The future rethrows what deserialize throws.
+    template <typename T>
+    std::future<void> deserialize_async(T &t, string file_name);
+    // Calls done with the result of try_deserialize, on a pool thread. If decoding throws, the
+    // result is DecodeErrc::exception_thrown.
+    template <typename T>
+    void deserialize_async(T &t, string file_name, std::function<void(DecodeResult)> done);
+
+    // definitions
+    template <typename T>
+    std::future<void> serialize_async(const T &t, string file_name) {
+      TRACE("serialize_async(const T& t, string file_name)");
+      return thread_pool().submit([&t, file_name = std::move(file_name)] { serialize(t, file_name); });
+    }
+    template <typename T>
+    std::future<void> deserialize_async(T &t, string file_name) {
+      TRACE("deserialize_async(T& t, string file_name)");
+      return thread_pool().submit([&t, file_name = std::move(file_name)] { deserialize(t, file_name); });
+    }
+    template <typename T>
+    void deserialize_async(T &t, string file_name, std::function<void(DecodeResult)> done) {
+      TRACE("deserialize_async(T& t, string file_name, std::function<void(DecodeResult)> done)");
+      thread_pool().post([&t, file_name = std::move(file_name), done = std::move(done)] {
+        DecodeResult r;
+        try {
+          r = try_deserialize(t, file_name);
+        } catch (...) {
+          r = DecodeResult{DecodeErrc::exception_thrown, 0};
+        }
+        done(r);
+      });
+    }
+  } // namespace binary
+} // namespace serializer
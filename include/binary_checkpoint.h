@@ -0,0 +1,236 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "binary_packed.h"
+#include "common.h"
+#include "errors.h"
+#include "libbinary.h"
+#include "type_utils.h"
+
+// Incremental checkpoints of maps.
+//
+// A checkpoint is a base snapshot, `<base>.base`, plus the delta files written after it,
+// `<base>.delta.<seq>`. The base holds the sequence number of the last delta folded into it, and
+// the map in its regular encoding. Each delta holds the keys upserted since the previous checkpoint
+// with their values, in the layout of the map itself, followed by the erased keys as a vector.
+// Writing a delta costs O(changes), while restoring replays the base and then every later delta.
+
+namespace serializer {
+  namespace binary {
+    namespace {
+      // Where TrackedMap records its changes: a map from key to whether it was erased, of the same
+      // kind (ordered or unordered) as the tracked map.
+      template <typename Map, bool = is_ordered_container_v<Map>>
+      struct ChangeSet {
+        using type = std::map<typename Map::key_type, bool, typename Map::key_compare>;
+      };
+      template <typename Map>
+      struct ChangeSet<Map, false> {
+        using type = std::unordered_map<typename Map::key_type, bool, typename Map::hasher, typename Map::key_equal>;
+      };
+    } // namespace
+
+    // A map that records which keys were upserted or erased since its changes were last cleared.
+    // The map can be read freely through data(), but must only be modified through this class.
+    template <typename Map>
+    class TrackedMap {
+    public:
+      static_assert(is_map_container_v<Map>, "Map must be a map container");
+      using key_type = typename Map::key_type;
+      using mapped_type = typename Map::mapped_type;
+
+      TrackedMap() = default;
+      explicit TrackedMap(Map data) : data_(std::move(data)) {}
+
+      const Map &data() const { return data_; }
+      size_t size() const { return data_.size(); }
+
+      void insert_or_assign(const key_type &key, mapped_type value) {
+        data_.insert_or_assign(key, std::move(value));
+        changes_[key] = false;
+      }
+      // Returns the value of key, inserting a default one if needed, and marks it as changed.
+      mapped_type &mutate(const key_type &key) {
+        changes_[key] = false;
+        return data_[key];
+      }
+      size_t erase(const key_type &key) {
+        const size_t erased = data_.erase(key);
+        if (erased != 0) {
+          changes_[key] = true;
+        }
+        return erased;
+      }
+
+      // Changed keys, each mapped to whether it was erased.
+      const typename ChangeSet<Map>::type &changes() const { return changes_; }
+      void clear_changes() { changes_.clear(); }
+
+    private:
+      Map data_;
+      typename ChangeSet<Map>::type changes_;
+    };
+
+    // Writes the checkpoints of one TrackedMap. Resumes after the last checkpoint found on disk.
+    template <typename Map>
+    class Checkpointer {
+    public:
+      // Every consolidate_every-th checkpoint is a new base instead of a delta.
+      explicit Checkpointer(string base_name, size_t consolidate_every = 16)
+          : base_name_(std::move(base_name)), consolidate_every_(consolidate_every) {
+        std::ifstream is(base_file_name(), std::ios::binary);
+        size_t offset = 0;
+        if (is.good() && _deserialize(seq_, is, offset) == DecodeErrc::ok) {
+          has_base_ = true;
+          while (std::filesystem::exists(delta_file_name(seq_ + 1))) {
+            seq_++;
+            deltas_++;
+          }
+        }
+      }
+
+      // Writes the changes of t since its last checkpoint, or a new base if it is time to
+      // consolidate, and clears the changes.
+      void checkpoint(TrackedMap<Map> &t) {
+        TRACE("Checkpointer::checkpoint(TrackedMap<Map>& t)");
+        if (!has_base_ || deltas_ + 1 >= consolidate_every_) {
+          consolidate(t);
+          return;
+        }
+        seq_++;
+        const string file_name = delta_file_name(seq_);
+        _write_atomically(file_name, [&](std::ostream &os) {
+          // One identity table for the whole delta, as try_restore_checkpoint uses when reading it.
+          [[maybe_unused]] pointer_scope_t<Map> pointer_scope;
+          const Map &data = t.data();
+          size_t upserts = 0;
+          for (const auto &[key, erased] : t.changes()) {
+            upserts += erased ? 0 : 1;
+          }
+          // the upserts, laid out like a map
+          _write(os, upserts, sizeof(upserts));
+          for (const auto &[key, erased] : t.changes()) {
+            if (!erased) {
+              serialize(key, os);
+              serialize(data.at(key), os);
+            }
+          }
+          // the tombstones, laid out like a vector
+          const size_t tombstones = t.changes().size() - upserts;
+          _write(os, tombstones, sizeof(tombstones));
+          for (const auto &[key, erased] : t.changes()) {
+            if (erased) {
+              serialize(key, os);
+            }
+          }
+        });
+        deltas_++;
+        t.clear_changes();
+      }
+
+      // Writes all of t as the new base, removes the deltas it replaces, and clears the changes.
+      void consolidate(TrackedMap<Map> &t) {
+        TRACE("Checkpointer::consolidate(TrackedMap<Map>& t)");
+        _write_atomically(base_file_name(), [&](std::ostream &os) {
+          serialize(seq_, os);
+          serialize(t.data(), os);
+        });
+        // The new base records seq_, so leftover deltas would be skipped anyway if this stops early.
+        for (size_t seq = seq_; seq > seq_ - deltas_; seq--) {
+          std::filesystem::remove(delta_file_name(seq));
+        }
+        has_base_ = true;
+        deltas_ = 0;
+        t.clear_changes();
+      }
+
+      string base_file_name() const { return base_name_ + ".base"; }
+      string delta_file_name(size_t seq) const { return base_name_ + ".delta." + std::to_string(seq); }
+
+    private:
+      template <typename Write>
+      static void _write_atomically(const string &file_name, Write write) {
+        // Readers only ever see complete files.
+        const string tmp_file_name = file_name + ".tmp";
+        std::ofstream os(tmp_file_name, std::ios::binary);
+        // Check if file is opened successfully
+        ASSERT(os.good());
+        write(os);
+        os.close();
+        ASSERT(!os.fail());
+        std::filesystem::rename(tmp_file_name, file_name);
+      }
+
+      string base_name_;
+      size_t consolidate_every_;
+      bool has_base_ = false;
+      // sequence number of the last checkpoint
+      size_t seq_ = 0;
+      // deltas written since the base
+      size_t deltas_ = 0;
+    };
+
+    // declarations
+    // Restores a map from its base and deltas. On failure, the offset is relative to the start of
+    // the file that failed.
+    template <typename Map>
+    DecodeResult try_restore_checkpoint(Map &t, const string &base_name);
+    template <typename Map>
+    void restore_checkpoint(Map &t, const string &base_name);
+
+    // definitions
+    template <typename Map>
+    DecodeResult try_restore_checkpoint(Map &t, const string &base_name) {
+      TRACE("try_restore_checkpoint(Map& t, const string &base_name)");
+      static_assert(is_map_container_v<Map>, "Map must be a map container");
+      std::ifstream base(base_name + ".base", std::ios::binary);
+      // Check if file exists
+      if (!base.good()) {
+        return DecodeResult{DecodeErrc::open_failed, 0};
+      }
+      DecodeResult r;
+      size_t seq;
+      r.code = _deserialize(seq, base, r.offset);
+      if (r) {
+        t.clear();
+        r.code = _deserialize(t, base, r.offset);
+      }
+      for (seq++; r; seq++) {
+        std::ifstream delta(base_name + ".delta." + std::to_string(seq), std::ios::binary);
+        if (!delta.good()) {
+          break;
+        }
+        r.offset = 0;
+        [[maybe_unused]] pointer_scope_t<Map> pointer_scope;
+        Map upserts;
+        std::vector<typename Map::key_type> tombstones;
+        r.code = _deserialize(upserts, delta, r.offset);
+        if (r) {
+          r.code = _deserialize(tombstones, delta, r.offset);
+        }
+        if (r) {
+          for (auto &[key, value] : upserts) {
+            t.insert_or_assign(key, std::move(value));
+          }
+          for (const auto &key : tombstones) {
+            t.erase(key);
+          }
+        }
+      }
+      return r;
+    }
+    template <typename Map>
+    void restore_checkpoint(Map &t, const string &base_name) {
+      TRACE("restore_checkpoint(Map& t, const string &base_name)");
+      _throw_if_failed(try_restore_checkpoint(t, base_name));
+    }
+  } // namespace binary
+} // namespace serializer
@@ -0,0 +1,291 @@
+#pragma once
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "common.h"
+#include "errors.h"
+#include "libbinary.h"
+#include "type_utils.h"
+
+// Columnar (struct-of-arrays) encoding for array containers of tuples and pair-like types.
+//
+// Layout: row count, column count, then for each column its size in bytes followed by its
+// payload. Arithmetic columns are stored as one raw array of values, other columns as their
+// elements in the regular binary encoding, one after another. Since every column is prefixed with
+// its size, a reader can skip to any column without decoding the others.
+
+namespace serializer {
+  // Check if a type is an array-like container of tuples or pair-like types.
+  namespace {
+    // fallback struct:
+    template <typename T, bool = is_array_container_v<T>>
+    struct CC {
+      static constexpr bool v = false;
+    };
+    template <typename T>
+    struct CC<T, true> {
+      static constexpr bool v = is_tuple_v<typename T::value_type> || is_pair_v<typename T::value_type>;
+    };
+  } // namespace
+  template <typename T>
+  constexpr auto is_columnar_container_v = CC<remove_cv_t<T>>::v;
+
+  namespace binary {
+    // declarations
+    template <typename T>
+    void serialize_columnar(const T &t, std::ostream &os);
+    template <typename T>
+    void serialize_columnar(const T &t, const string &file_name);
+
+    template <typename T>
+    void deserialize_columnar(T &t, std::istream &is);
+    template <typename T>
+    void deserialize_columnar(T &t, const string &file_name);
+
+    // Reads only the given column of data written by serialize_columnar. E must be the type of
+    // that column.
+    template <typename E>
+    void deserialize_column(std::vector<E> &column, size_t index, std::istream &is);
+    template <typename E>
+    void deserialize_column(std::vector<E> &column, size_t index, const string &file_name);
+
+    namespace {
+      // std::get does not work with every pair-like type, so pairs are accessed by member.
+      template <size_t I, typename Row>
+      auto &_column_ref(Row &row) {
+        if constexpr (is_pair_v<Row>) {
+          static_assert(I < 2, "pairs only have two columns");
+          if constexpr (I == 0) {
+            return row.first;
+          } else {
+            return row.second;
+          }
+        } else {
+          return std::get<I>(row);
+        }
+      }
+
+      template <size_t I, typename Row>
+      using column_t = std::decay_t<decltype(_column_ref<I>(std::declval<Row &>()))>;
+
+      template <typename Row>
+      constexpr size_t _column_count() {
+        if constexpr (is_pair_v<Row>) {
+          return 2;
+        } else {
+          return std::tuple_size_v<Row>;
+        }
+      }
+
+      // Calls f(std::integral_constant<size_t, I>) for every column I of Row.
+      template <typename Row, size_t I = 0, typename Func>
+      void _foreach_column(Func f) {
+        if constexpr (I < _column_count<Row>()) {
+          f(std::integral_constant<size_t, I>{});
+          _foreach_column<Row, I + 1>(f);
+        }
+      }
+
+      // The smallest number of bytes one row takes in the input, for DecodeLimits.
+      template <typename Row, size_t I = 0>
+      constexpr size_t _min_encoded_row_size() {
+        if constexpr (I == _column_count<Row>()) {
+          return 0;
+        } else if constexpr (std::is_arithmetic_v<column_t<I, Row>>) {
+          return sizeof(column_t<I, Row>) + _min_encoded_row_size<Row, I + 1>();
+        } else {
+          return sizeof(size_t) + _min_encoded_row_size<Row, I + 1>();
+        }
+      }
+
+      template <size_t I, typename T>
+      void _write_column(const T &t, std::ostream &os) {
+        TRACE("_write_column(const T& t, std::ostream& os)");
+        using E = column_t<I, const typename T::value_type>;
+        if constexpr (std::is_arithmetic_v<E>) {
+          // Not a std::vector<E>, which has no data() for bool.
+          std::unique_ptr<E[]> values(new E[t.size()]);
+          size_t k = 0;
+          for (const auto &row : t) {
+            values[k++] = _column_ref<I>(row);
+          }
+          const size_t bytes = t.size() * sizeof(E);
+          _write(os, bytes, sizeof(bytes));
+          os.write(reinterpret_cast<const char *>(values.get()), bytes);
+        } else {
+          // The size of a column of non-arithmetic values is only known once it is encoded.
+          std::ostringstream buf;
+          for (const auto &row : t) {
+            serialize(_column_ref<I>(row), buf);
+          }
+          const string bytes = buf.str();
+          _write(os, bytes.size(), sizeof(size_t));
+          os.write(bytes.data(), bytes.size());
+        }
+        ASSERT(os.good());
+      }
+
+      // Decodes the payload of one column of `rows` values, calling store(k, value) for each.
+      template <typename E, typename Store>
+      DecodeErrc _read_column(std::istream &is, size_t &offset, size_t rows, Store store) {
+        TRACE("_read_column(std::istream& is, size_t& offset, size_t rows, Store store)");
+        const size_t start = offset;
+        size_t bytes;
+        RETURN_IF_ERROR(_read(is, bytes, offset));
+        if constexpr (std::is_arithmetic_v<E>) {
+          if (bytes % sizeof(E) != 0 || bytes / sizeof(E) != rows) {
+            offset = start;
+            return DecodeErrc::size_mismatch;
+          }
+          std::unique_ptr<E[]> values(new E[rows]);
+          if (!is.read(reinterpret_cast<char *>(values.get()), bytes)) {
+            return DecodeErrc::truncated;
+          }
+          offset += bytes;
+          for (size_t k = 0; k < rows; k++) {
+            store(k, values[k]);
+          }
+        } else {
+          const size_t payload = offset;
+          for (size_t k = 0; k < rows; k++) {
+            E value{};
+            RETURN_IF_ERROR(_deserialize(value, is, offset));
+            store(k, std::move(value));
+          }
+          if (offset - payload != bytes) {
+            offset = start;
+            return DecodeErrc::size_mismatch;
+          }
+        }
+        return DecodeErrc::ok;
+      }
+
+      // Reads the row and column counts.
+      inline DecodeErrc _read_columnar_header(std::istream &is, size_t &offset, size_t &rows, size_t &columns,
+                                              size_t min_encoded_row_size, size_t row_size) {
+        RETURN_IF_ERROR(_read_length(is, rows, offset, min_encoded_row_size == 0 ? 1 : min_encoded_row_size, row_size));
+        return _read(is, columns, offset);
+      }
+
+      template <typename T>
+      DecodeErrc _deserialize_columnar(T &t, std::istream &is, size_t &offset) {
+        TRACE("_deserialize_columnar(T& t, std::istream& is, size_t& offset)");
+        using Row = typename T::value_type;
+        DepthGuard depth_guard;
+        RETURN_IF_ERROR(depth_guard.status());
+        size_t rows, columns;
+        const size_t start = offset;
+        RETURN_IF_ERROR(_read_columnar_header(is, offset, rows, columns, _min_encoded_row_size<Row>(), sizeof(Row)));
+        if (columns != _column_count<Row>()) {
+          offset = start;
+          return DecodeErrc::size_mismatch;
+        }
+        t.clear();
+        t.resize(rows);
+        // Random access into the rows, so that std::list is filled in one pass per column too.
+        std::vector<Row *> row_ptrs;
+        row_ptrs.reserve(rows);
+        for (auto &row : t) {
+          row_ptrs.push_back(&row);
+        }
+        DecodeErrc e = DecodeErrc::ok;
+        _foreach_column<Row>([&](auto column) {
+          constexpr size_t I = decltype(column)::value;
+          if (e == DecodeErrc::ok) {
+            e = _read_column<column_t<I, Row>>(
+                is, offset, rows, [&](size_t k, auto &&value) { _column_ref<I>(*row_ptrs[k]) = std::move(value); });
+          }
+        });
+        return e;
+      }
+
+      template <typename E>
+      DecodeErrc _deserialize_column(std::vector<E> &column, size_t index, std::istream &is, size_t &offset) {
+        TRACE("_deserialize_column(std::vector<E>& column, size_t index, std::istream& is, size_t& offset)");
+        size_t rows, columns;
+        const size_t start = offset;
+        RETURN_IF_ERROR(_read_columnar_header(is, offset, rows, columns, std::is_arithmetic_v<E> ? sizeof(E) : 1,
+                                              sizeof(E)));
+        if (index >= columns) {
+          offset = start;
+          return DecodeErrc::size_mismatch;
+        }
+        // skip the columns before the one we want
+        for (size_t i = 0; i < index; i++) {
+          size_t bytes;
+          RETURN_IF_ERROR(_read(is, bytes, offset));
+          if (!is.ignore(bytes) || static_cast<size_t>(is.gcount()) != bytes) {
+            return DecodeErrc::truncated;
+          }
+          offset += bytes;
+        }
+        column.clear();
+        column.resize(rows);
+        return _read_column<E>(is, offset, rows, [&](size_t k, auto &&value) { column[k] = std::move(value); });
+      }
+    } // namespace
+
+    // definitions
+    template <typename T>
+    void serialize_columnar(const T &t, std::ostream &os) {
+      TRACE("serialize_columnar(const T& t, std::ostream& os)");
+      static_assert(is_columnar_container_v<T>, "T must be a vector or list of tuples or pairs");
+      using Row = typename T::value_type;
+      const size_t rows = t.size();
+      constexpr size_t columns = _column_count<Row>();
+      _write(os, rows, sizeof(rows));
+      _write(os, columns, sizeof(columns));
+      _foreach_column<Row>([&](auto column) { _write_column<decltype(column)::value>(t, os); });
+    }
+    template <typename T>
+    void serialize_columnar(const T &t, const string &file_name) {
+      TRACE("serialize_columnar(const T& t, const string &file_name)");
+      std::ofstream os(file_name, std::ios::binary);
+      // Check if file is opened successfully
+      ASSERT(os.good());
+      serialize_columnar(t, os);
+      os.close();
+    }
+
+    template <typename T>
+    void deserialize_columnar(T &t, std::istream &is) {
+      TRACE("deserialize_columnar(T& t, std::istream& is)");
+      static_assert(is_columnar_container_v<T>, "T must be a vector or list of tuples or pairs");
+      DecodeResult r;
+      r.code = _deserialize_columnar(t, is, r.offset);
+      _throw_if_failed(r);
+    }
+    template <typename T>
+    void deserialize_columnar(T &t, const string &file_name) {
+      TRACE("deserialize_columnar(T& t, const string &file_name)");
+      std::ifstream is(file_name, std::ios::binary);
+      // Check if file exists
+      ASSERT(is.good());
+      deserialize_columnar(t, is);
+    }
+
+    template <typename E>
+    void deserialize_column(std::vector<E> &column, size_t index, std::istream &is) {
+      TRACE("deserialize_column(std::vector<E>& column, size_t index, std::istream& is)");
+      DecodeResult r;
+      r.code = _deserialize_column(column, index, is, r.offset);
+      _throw_if_failed(r);
+    }
+    template <typename E>
+    void deserialize_column(std::vector<E> &column, size_t index, const string &file_name) {
+      TRACE("deserialize_column(std::vector<E>& column, size_t index, const string &file_name)");
+      std::ifstream is(file_name, std::ios::binary);
+      // Check if file exists
+      ASSERT(is.good());
+      deserialize_column(column, index, is);
+    }
+  } // namespace binary
+} // namespace serializer
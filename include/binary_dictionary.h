@@ -0,0 +1,304 @@
+#pragma once
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "binary_packed.h"
+#include "common.h"
+#include "errors.h"
+#include "libbinary.h"
+#include "type_utils.h"
+
+// Dictionary encoding for containers of repetitive strings.
+//
+// Layout: the number of distinct strings, each distinct string once in the regular encoding, the
+// element count, then one block of ids as varints, one id per string of every element, in
+// iteration order. For maps, the side that is not a string follows the ids block, one value per
+// element in the regular encoding.
+//
+// Strings may be std::string or std::string_view. A std::string_view can only be loaded with an
+// InternPool, which owns the characters it points to.
+
+namespace serializer {
+  namespace {
+    template <typename S>
+    constexpr bool is_dictionary_string_v =
+        std::is_same_v<remove_cv_t<S>, string> || std::is_same_v<remove_cv_t<S>, std::string_view>;
+
+    // fallback struct:
+    template <typename T, typename U = void>
+    struct DC {
+      static constexpr bool v = false;
+      static constexpr bool has_view = false;
+    };
+    template <typename T>
+    struct DC<T, std::enable_if_t<is_array_container_v<T>>> {
+      static constexpr bool v = is_dictionary_string_v<typename T::value_type>;
+      static constexpr bool has_view = std::is_same_v<typename T::value_type, std::string_view>;
+    };
+    template <typename T>
+    struct DC<T, std::enable_if_t<is_map_container_v<T>>> {
+      static constexpr bool v =
+          is_dictionary_string_v<typename T::key_type> || is_dictionary_string_v<typename T::mapped_type>;
+      static constexpr bool has_view = std::is_same_v<typename T::key_type, std::string_view> ||
+                                       std::is_same_v<typename T::mapped_type, std::string_view>;
+    };
+  } // namespace
+  // Check if a type is an array container of strings, or a map container with string keys or values.
+  template <typename T>
+  constexpr auto is_dictionary_container_v = DC<remove_cv_t<T>>::v;
+
+  namespace binary {
+    // Owns the strings loaded by deserialize_dictionary, once per distinct value, for as long as the
+    // string_views pointing into it are in use. A pool may be shared by any number of loads.
+    class InternPool {
+    public:
+      std::string_view intern(string s) { return *strings_.insert(std::move(s)).first; }
+      size_t size() const { return strings_.size(); }
+      void clear() { strings_.clear(); }
+
+    private:
+      // Nodes never move, so the views stay valid when the set grows.
+      std::unordered_set<string> strings_;
+    };
+
+    // declarations
+    template <typename T>
+    void serialize_dictionary(const T &t, std::ostream &os);
+    template <typename T>
+    void serialize_dictionary(const T &t, const string &file_name);
+
+    template <typename T>
+    void deserialize_dictionary(T &t, std::istream &is);
+    template <typename T>
+    void deserialize_dictionary(T &t, const string &file_name);
+    // Distinct strings are interned into `pool`, so std::string_view elements of t point into it.
+    template <typename T>
+    void deserialize_dictionary(T &t, std::istream &is, InternPool &pool);
+    template <typename T>
+    void deserialize_dictionary(T &t, const string &file_name, InternPool &pool);
+
+    namespace {
+      // Assigns ids to distinct strings in the order they are first seen.
+      class DictionaryBuilder {
+      public:
+        void add(std::string_view s) {
+          auto [it, inserted] = ids_.emplace(s, ids_.size());
+          if (inserted) {
+            strings_.push_back(s);
+          }
+          _put_varint(ids_block_, it->second);
+        }
+        void write(std::ostream &os, size_t count) const {
+          const size_t distinct = strings_.size();
+          _write(os, distinct, sizeof(distinct));
+          for (std::string_view s : strings_) {
+            _write(os, s.data(), s.size());
+          }
+          _write(os, count, sizeof(count));
+          _write(os, ids_block_);
+        }
+
+      private:
+        std::unordered_map<std::string_view, uint64_t> ids_;
+        std::vector<std::string_view> strings_;
+        string ids_block_;
+      };
+
+      // The distinct strings of one load, and the ids block that refers to them.
+      struct Dictionary {
+        std::vector<string> strings;
+        std::vector<std::string_view> views;
+        string ids_block;
+        const unsigned char *next = nullptr;
+
+        // Stores the string of the next id into s.
+        template <typename S>
+        DecodeErrc take(S &s) {
+          const unsigned char *end = reinterpret_cast<const unsigned char *>(ids_block.data()) + ids_block.size();
+          uint64_t id;
+          if (!_get_varint(next, end, id)) {
+            return DecodeErrc::truncated;
+          }
+          if (id >= strings.size()) {
+            return DecodeErrc::size_mismatch;
+          }
+          if constexpr (std::is_same_v<S, std::string_view>) {
+            s = views[id];
+          } else {
+            s = strings[id];
+          }
+          return DecodeErrc::ok;
+        }
+      };
+
+      template <typename T>
+      DecodeErrc _deserialize_dictionary(T &t, std::istream &is, size_t &offset, InternPool *pool) {
+        TRACE("_deserialize_dictionary(T& t, std::istream& is, size_t& offset, InternPool* pool)");
+        DepthGuard depth_guard;
+        RETURN_IF_ERROR(depth_guard.status());
+        Dictionary dict;
+        size_t distinct;
+        RETURN_IF_ERROR(_read_length(is, distinct, offset, sizeof(size_t), sizeof(string)));
+        // The strings are appended as they are read, so a crafted count fails at the end of the
+        // input instead of allocating distinct strings up front.
+        for (size_t i = 0; i < distinct; i++) {
+          string s;
+          RETURN_IF_ERROR(_read(is, s, offset));
+          dict.strings.push_back(std::move(s));
+        }
+        if (pool != nullptr) {
+          dict.views.reserve(distinct);
+          for (string &s : dict.strings) {
+            dict.views.push_back(pool->intern(s));
+          }
+        }
+        size_t count;
+        // at least one byte for an id, plus the bookkeeping of a node for maps
+        constexpr size_t element_size = is_map_container_v<T> ? sizeof(typename T::value_type) + 4 * sizeof(void *)
+                                                               : sizeof(typename T::value_type);
+        RETURN_IF_ERROR(_read_length(is, count, offset, 1, element_size));
+        const size_t ids_start = offset;
+        RETURN_IF_ERROR(_read(is, dict.ids_block, offset));
+        dict.next = reinterpret_cast<const unsigned char *>(dict.ids_block.data());
+        const size_t values_start = offset;
+        // every element has at least one id of one byte
+        if (count > dict.ids_block.size()) {
+          offset = ids_start;
+          return DecodeErrc::truncated;
+        }
+        DecodeErrc e = DecodeErrc::ok;
+        t.clear();
+        if constexpr (is_array_container_v<T>) {
+          t.resize(count);
+          for (auto &elem : t) {
+            if ((e = dict.take(elem)) != DecodeErrc::ok) {
+              break;
+            }
+          }
+        } else {
+          using K = typename T::key_type;
+          using V = typename T::mapped_type;
+          for (size_t i = 0; i < count && e == DecodeErrc::ok; i++) {
+            K key{};
+            V value{};
+            if constexpr (is_dictionary_string_v<K>) {
+              e = dict.take(key);
+            } else {
+              e = _deserialize(key, is, offset);
+            }
+            if (e != DecodeErrc::ok) {
+              break;
+            }
+            if constexpr (is_dictionary_string_v<V>) {
+              e = dict.take(value);
+            } else {
+              e = _deserialize(value, is, offset);
+            }
+            if (e == DecodeErrc::ok) {
+              t.emplace_hint(t.end(), std::move(key), std::move(value));
+            }
+          }
+        }
+        if (e != DecodeErrc::ok) {
+          // Errors in the ids block are reported at its start, and errors in the values where
+          // _deserialize left the offset.
+          if (offset == values_start) {
+            offset = ids_start;
+          }
+          return e;
+        }
+        if (dict.next != reinterpret_cast<const unsigned char *>(dict.ids_block.data()) + dict.ids_block.size()) {
+          offset = ids_start;
+          return DecodeErrc::size_mismatch;
+        }
+        return DecodeErrc::ok;
+      }
+    } // namespace
+
+    // definitions
+    template <typename T>
+    void serialize_dictionary(const T &t, std::ostream &os) {
+      TRACE("serialize_dictionary(const T& t, std::ostream& os)");
+      static_assert(is_dictionary_container_v<T>, "T must be an array or map container of strings");
+      DictionaryBuilder dict;
+      if constexpr (is_array_container_v<T>) {
+        for (const auto &elem : t) {
+          dict.add(elem);
+        }
+        dict.write(os, t.size());
+      } else {
+        using K = typename T::key_type;
+        using V = typename T::mapped_type;
+        for (const auto &elem : t) {
+          if constexpr (is_dictionary_string_v<K>) {
+            dict.add(elem.first);
+          }
+          if constexpr (is_dictionary_string_v<V>) {
+            dict.add(elem.second);
+          }
+        }
+        dict.write(os, t.size());
+        for (const auto &elem : t) {
+          if constexpr (!is_dictionary_string_v<K>) {
+            serialize(elem.first, os);
+          }
+          if constexpr (!is_dictionary_string_v<V>) {
+            serialize(elem.second, os);
+          }
+        }
+      }
+      ASSERT(os.good());
+    }
+    template <typename T>
+    void serialize_dictionary(const T &t, const string &file_name) {
+      TRACE("serialize_dictionary(const T& t, const string &file_name)");
+      std::ofstream os(file_name, std::ios::binary);
+      // Check if file is opened successfully
+      ASSERT(os.good());
+      serialize_dictionary(t, os);
+      os.close();
+    }
+
+    template <typename T>
+    void deserialize_dictionary(T &t, std::istream &is) {
+      TRACE("deserialize_dictionary(T& t, std::istream& is)");
+      static_assert(is_dictionary_container_v<T>, "T must be an array or map container of strings");
+      static_assert(!DC<remove_cv_t<T>>::has_view, "loading std::string_view requires an InternPool");
+      DecodeResult r;
+      r.code = _deserialize_dictionary(t, is, r.offset, nullptr);
+      _throw_if_failed(r);
+    }
+    template <typename T>
+    void deserialize_dictionary(T &t, const string &file_name) {
+      TRACE("deserialize_dictionary(T& t, const string &file_name)");
+      std::ifstream is(file_name, std::ios::binary);
+      // Check if file exists
+      ASSERT(is.good());
+      deserialize_dictionary(t, is);
+    }
+    template <typename T>
+    void deserialize_dictionary(T &t, std::istream &is, InternPool &pool) {
+      TRACE("deserialize_dictionary(T& t, std::istream& is, InternPool& pool)");
+      static_assert(is_dictionary_container_v<T>, "T must be an array or map container of strings");
+      DecodeResult r;
+      r.code = _deserialize_dictionary(t, is, r.offset, &pool);
+      _throw_if_failed(r);
+    }
+    template <typename T>
+    void deserialize_dictionary(T &t, const string &file_name, InternPool &pool) {
+      TRACE("deserialize_dictionary(T& t, const string &file_name, InternPool& pool)");
+      std::ifstream is(file_name, std::ios::binary);
+      // Check if file exists
+      ASSERT(is.good());
+      deserialize_dictionary(t, is, pool);
+    }
+  } // namespace binary
+} // namespace serializer
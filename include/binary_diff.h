@@ -0,0 +1,406 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "common.h"
+#include "errors.h"
+#include "fingerprint.h"
+#include "libbinary.h"
+#include "type_utils.h"
+
+// Structural patches between two values of the same type.
+//
+// serialize_patch walks an old and a new value side by side and writes only what differs, so that
+// apply_patch can turn a copy of the old value into the new one in place. A patch starts with the
+// type fingerprint of T, followed by one node for the whole value. A node is an operation, then:
+//  - keep: nothing, the value is unchanged;
+//  - replace: the new value, in the regular encoding;
+//  - patch, for pairs and tuples: one node per element;
+//  - patch, for vectors and lists: the new size, the number of changed elements, each changed
+//    element as its index and a node, then the elements past the old size in the regular encoding;
+//  - patch, for maps: the erased keys, then the number of upserted entries, each as its key and a
+//    node (a replace for new keys);
+//  - patch, for sets: the erased elements, then the inserted ones.
+// Everything else, strings included, is either kept or replaced as a whole.
+
+namespace serializer {
+  namespace binary {
+    // declarations
+    template <typename T>
+    void serialize_patch(const T &from, const T &to, std::ostream &os);
+    template <typename T>
+    void serialize_patch(const T &from, const T &to, const string &file_name);
+
+    // t must be equal to the `from` the patch was made from. On failure, t is left partially
+    // patched.
+    template <typename T>
+    DecodeResult try_apply_patch(T &t, std::istream &is);
+    template <typename T>
+    DecodeResult try_apply_patch(T &t, const string &file_name);
+    template <typename T>
+    void apply_patch(T &t, std::istream &is);
+    template <typename T>
+    void apply_patch(T &t, const string &file_name);
+
+    namespace {
+      enum PatchOp : size_t { patch_keep = 0, patch_replace = 1, patch_patch = 2 };
+
+      inline void _write_op(std::ostream &os, PatchOp op) {
+        const size_t value = op;
+        _write(os, value, sizeof(value));
+      }
+
+      template <typename T>
+      bool _equal(const T &a, const T &b);
+      template <typename T>
+      void _write_patch(const T &from, const T &to, std::ostream &os);
+      template <typename T>
+      DecodeErrc _apply_patch(T &t, std::istream &is, size_t &offset);
+
+      template <typename T, size_t... I>
+      bool _tuple_equal(const T &a, const T &b, std::index_sequence<I...>) {
+        return (_equal(std::get<I>(a), std::get<I>(b)) && ...);
+      }
+
+      // Deep equality, which only needs operator== on the arithmetic types and strings the format
+      // is built from.
+      template <typename T>
+      bool _equal(const T &a, const T &b) {
+        if constexpr (is_pair_v<T>) {
+          return _equal(a.first, b.first) && _equal(a.second, b.second);
+        } else if constexpr (is_bool_vector_v<T> || is_bitset_v<T>) {
+          return a == b;
+        } else if constexpr (is_array_container_v<T>) {
+          if (a.size() != b.size()) {
+            return false;
+          }
+          for (auto i = a.begin(), j = b.begin(); i != a.end(); ++i, ++j) {
+            if (!_equal(*i, *j)) {
+              return false;
+            }
+          }
+          return true;
+        } else if constexpr (is_tuple_v<T>) {
+          return _tuple_equal(a, b, std::make_index_sequence<std::tuple_size_v<T>>{});
+        } else if constexpr (is_map_container_v<T>) {
+          if (a.size() != b.size()) {
+            return false;
+          }
+          for (const auto &elem : a) {
+            auto it = b.find(elem.first);
+            if (it == b.end() || !_equal(elem.second, it->second)) {
+              return false;
+            }
+          }
+          return true;
+        } else if constexpr (is_set_container_v<T>) {
+          if (a.size() != b.size()) {
+            return false;
+          }
+          for (const auto &elem : a) {
+            if (b.find(elem) == b.end()) {
+              return false;
+            }
+          }
+          return true;
+        } else if constexpr (is_cstring_v<T>) {
+          return strcmp(a, b) == 0;
+        } else if constexpr (is_supported_literal_v<T>) {
+          return a == b;
+        } else if constexpr (is_shared_ptr_v<T> || is_unique_ptr_v<T>) {
+          if (!a || !b) {
+            return !a && !b;
+          }
+          return a.get() == b.get() || _equal(*a, *b);
+        } else if constexpr (is_base_of_v<BinSerializable, remove_cv_t<T>>) {
+          return a.serializeToString() == b.serializeToString();
+        } else {
+          static_assert(always_false<T>, "T is not a supported type");
+        }
+      }
+
+      template <typename T, size_t... I>
+      void _write_tuple_patch(const T &from, const T &to, std::ostream &os, std::index_sequence<I...>) {
+        (_write_patch(std::get<I>(from), std::get<I>(to), os), ...);
+      }
+
+      template <typename T>
+      void _write_patch(const T &from, const T &to, std::ostream &os) {
+        TRACE("_write_patch(const T& from, const T& to, std::ostream& os)");
+        if (_equal(from, to)) {
+          _write_op(os, patch_keep);
+          return;
+        }
+        if constexpr (is_bool_vector_v<T>) {
+          _write_op(os, patch_replace);
+          serialize(to, os);
+        } else if constexpr (is_pair_v<T>) {
+          _write_op(os, patch_patch);
+          _write_patch(from.first, to.first, os);
+          _write_patch(from.second, to.second, os);
+        } else if constexpr (is_array_container_v<T>) {
+          _write_op(os, patch_patch);
+          const size_t size = to.size();
+          _write(os, size, sizeof(size));
+          // the changed elements among the ones both have
+          std::vector<size_t> changed;
+          auto i = from.begin();
+          auto j = to.begin();
+          for (size_t index = 0; i != from.end() && j != to.end(); ++i, ++j, ++index) {
+            if (!_equal(*i, *j)) {
+              changed.push_back(index);
+            }
+          }
+          const size_t count = changed.size();
+          _write(os, count, sizeof(count));
+          i = from.begin();
+          j = to.begin();
+          size_t index = 0;
+          for (size_t c : changed) {
+            std::advance(i, c - index);
+            std::advance(j, c - index);
+            index = c;
+            _write(os, c, sizeof(c));
+            _write_patch(*i, *j, os);
+          }
+          // the elements past the old size
+          for (j = std::next(to.begin(), std::min(from.size(), to.size())); j != to.end(); ++j) {
+            serialize(*j, os);
+          }
+        } else if constexpr (is_tuple_v<T>) {
+          _write_op(os, patch_patch);
+          _write_tuple_patch(from, to, os, std::make_index_sequence<std::tuple_size_v<T>>{});
+        } else if constexpr (is_map_container_v<T>) {
+          _write_op(os, patch_patch);
+          std::vector<const typename T::key_type *> erased;
+          for (const auto &elem : from) {
+            if (to.find(elem.first) == to.end()) {
+              erased.push_back(&elem.first);
+            }
+          }
+          size_t size = erased.size();
+          _write(os, size, sizeof(size));
+          for (const auto *key : erased) {
+            serialize(*key, os);
+          }
+          std::vector<std::pair<const typename T::value_type *, const typename T::mapped_type *>> upserted;
+          for (const auto &elem : to) {
+            auto it = from.find(elem.first);
+            if (it == from.end()) {
+              upserted.emplace_back(&elem, nullptr);
+            } else if (!_equal(it->second, elem.second)) {
+              upserted.emplace_back(&elem, &it->second);
+            }
+          }
+          size = upserted.size();
+          _write(os, size, sizeof(size));
+          for (const auto &[elem, old_value] : upserted) {
+            serialize(elem->first, os);
+            if (old_value != nullptr) {
+              _write_patch(*old_value, elem->second, os);
+            } else {
+              _write_op(os, patch_replace);
+              serialize(elem->second, os);
+            }
+          }
+        } else if constexpr (is_set_container_v<T>) {
+          _write_op(os, patch_patch);
+          // the elements of a missing from b
+          auto write_missing = [&os](const T &a, const T &b) {
+            size_t size = 0;
+            for (const auto &elem : a) {
+              size += b.find(elem) == b.end() ? 1 : 0;
+            }
+            _write(os, size, sizeof(size));
+            for (const auto &elem : a) {
+              if (b.find(elem) == b.end()) {
+                serialize(elem, os);
+              }
+            }
+          };
+          write_missing(from, to);
+          write_missing(to, from);
+        } else {
+          _write_op(os, patch_replace);
+          serialize(to, os);
+        }
+      }
+
+      template <typename T, size_t... I>
+      DecodeErrc _apply_tuple_patch(T &t, std::istream &is, size_t &offset, std::index_sequence<I...>) {
+        DecodeErrc e = DecodeErrc::ok;
+        ((e = e == DecodeErrc::ok ? _apply_patch(std::get<I>(t), is, offset) : e), ...);
+        return e;
+      }
+
+      template <typename T>
+      DecodeErrc _apply_patch(T &t, std::istream &is, size_t &offset) {
+        TRACE("_apply_patch(T& t, std::istream& is, size_t& offset)");
+        DepthGuard depth_guard;
+        RETURN_IF_ERROR(depth_guard.status());
+        const size_t start = offset;
+        size_t op;
+        RETURN_IF_ERROR(_read(is, op, offset));
+        if (op == patch_keep) {
+          return DecodeErrc::ok;
+        }
+        if (op == patch_replace) {
+          // deserialize adds to what is already there
+          t = T();
+          return _deserialize(t, is, offset);
+        }
+        constexpr bool patchable = !is_bool_vector_v<T> && (is_pair_v<T> || is_array_container_v<T> || is_tuple_v<T> ||
+                                                            is_map_container_v<T> || is_set_container_v<T>);
+        if (op != patch_patch || !patchable) {
+          offset = start;
+          return DecodeErrc::patch_mismatch;
+        }
+        if constexpr (!patchable) {
+          return DecodeErrc::patch_mismatch;
+        } else if constexpr (is_pair_v<T>) {
+          RETURN_IF_ERROR(_apply_patch(t.first, is, offset));
+          return _apply_patch(t.second, is, offset);
+        } else if constexpr (is_array_container_v<T>) {
+          const size_t size_start = offset;
+          size_t size;
+          RETURN_IF_ERROR(_read(is, size, offset));
+          const size_t old_size = t.size();
+          // Only the elements past the old size are in the patch, each taking at least a size_t.
+          DecodeContext *ctx = current_decode_context();
+          if (ctx != nullptr && size > old_size) {
+            const DecodeErrc e =
+                ctx->check_container(is, size - old_size, sizeof(size_t), sizeof(typename T::value_type));
+            if (e != DecodeErrc::ok) {
+              offset = size_start;
+              return e;
+            }
+          }
+          size_t count;
+          RETURN_IF_ERROR(_read(is, count, offset));
+          auto it = t.begin();
+          size_t index = 0;
+          for (size_t i = 0; i < count; i++) {
+            const size_t index_start = offset;
+            size_t c;
+            RETURN_IF_ERROR(_read(is, c, offset));
+            if (c < index || c >= std::min(old_size, size)) {
+              offset = index_start;
+              return DecodeErrc::patch_mismatch;
+            }
+            std::advance(it, c - index);
+            index = c;
+            RETURN_IF_ERROR(_apply_patch(*it, is, offset));
+          }
+          if (size < old_size) {
+            t.resize(size);
+          }
+          // New elements are appended as they are read, so that a bogus size runs out of input
+          // instead of being allocated up front.
+          for (size_t i = old_size; i < size; i++) {
+            typename T::value_type elem{};
+            RETURN_IF_ERROR(_deserialize(elem, is, offset));
+            t.push_back(std::move(elem));
+          }
+          return DecodeErrc::ok;
+        } else if constexpr (is_tuple_v<T>) {
+          return _apply_tuple_patch(t, is, offset, std::make_index_sequence<std::tuple_size_v<T>>{});
+        } else if constexpr (is_map_container_v<T>) {
+          size_t size;
+          RETURN_IF_ERROR(_read(is, size, offset));
+          for (size_t i = 0; i < size; i++) {
+            typename T::key_type key;
+            RETURN_IF_ERROR(_deserialize(key, is, offset));
+            t.erase(key);
+          }
+          RETURN_IF_ERROR(_read(is, size, offset));
+          for (size_t i = 0; i < size; i++) {
+            typename T::key_type key;
+            RETURN_IF_ERROR(_deserialize(key, is, offset));
+            RETURN_IF_ERROR(_apply_patch(t.try_emplace(std::move(key)).first->second, is, offset));
+          }
+          return DecodeErrc::ok;
+        } else {
+          size_t size;
+          RETURN_IF_ERROR(_read(is, size, offset));
+          for (size_t i = 0; i < size; i++) {
+            typename T::value_type value;
+            RETURN_IF_ERROR(_deserialize(value, is, offset));
+            t.erase(value);
+          }
+          RETURN_IF_ERROR(_read(is, size, offset));
+          for (size_t i = 0; i < size; i++) {
+            typename T::value_type value;
+            RETURN_IF_ERROR(_deserialize(value, is, offset));
+            t.insert(std::move(value));
+          }
+          return DecodeErrc::ok;
+        }
+      }
+    } // namespace
+
+    // definitions
+    template <typename T>
+    void serialize_patch(const T &from, const T &to, std::ostream &os) {
+      TRACE("serialize_patch(const T& from, const T& to, std::ostream& os)");
+      // One identity table for all the values the patch replaces.
+      [[maybe_unused]] pointer_scope_t<T> pointer_scope;
+      const uint64_t fingerprint = type_fingerprint_v<T>;
+      _write(os, fingerprint, sizeof(fingerprint));
+      _write_patch(from, to, os);
+    }
+    template <typename T>
+    void serialize_patch(const T &from, const T &to, const string &file_name) {
+      TRACE("serialize_patch(const T& from, const T& to, const string &file_name)");
+      std::ofstream os(file_name, std::ios::binary);
+      // Check if file is opened successfully
+      ASSERT(os.good());
+      serialize_patch(from, to, os);
+      os.close();
+    }
+
+    template <typename T>
+    DecodeResult try_apply_patch(T &t, std::istream &is) {
+      TRACE("try_apply_patch(T& t, std::istream& is)");
+      uint64_t fingerprint;
+      DecodeResult r = read_fingerprint(fingerprint, is);
+      if (!r) {
+        return r;
+      }
+      if (fingerprint != type_fingerprint_v<T>) {
+        return DecodeResult{DecodeErrc::fingerprint_mismatch, 0};
+      }
+      [[maybe_unused]] pointer_scope_t<T> pointer_scope;
+      r.code = _apply_patch(t, is, r.offset);
+      return r;
+    }
+    template <typename T>
+    DecodeResult try_apply_patch(T &t, const string &file_name) {
+      TRACE("try_apply_patch(T& t, const string &file_name)");
+      std::ifstream is(file_name, std::ios::binary);
+      // Check if file exists
+      if (!is.good()) {
+        return DecodeResult{DecodeErrc::open_failed, 0};
+      }
+      return try_apply_patch(t, is);
+    }
+    template <typename T>
+    void apply_patch(T &t, std::istream &is) {
+      TRACE("apply_patch(T& t, std::istream& is)");
+      _throw_if_failed(try_apply_patch(t, is));
+    }
+    template <typename T>
+    void apply_patch(T &t, const string &file_name) {
+      TRACE("apply_patch(T& t, const string &file_name)");
+      _throw_if_failed(try_apply_patch(t, file_name));
+    }
+  } // namespace binary
+} // namespace serializer
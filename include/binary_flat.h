@@ -0,0 +1,386 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <new>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SERIALIZER_FLAT_MMAP 1
+#else
+#define SERIALIZER_FLAT_MMAP 0
+#endif
+
+#include "common.h"
+#include "errors.h"
+#include "fingerprint.h"
+#include "libbinary.h"
+#include "type_utils.h"
+
+// A flat layout that is read in place, e.g. from a memory-mapped file, instead of being decoded.
+//
+// Supported types are arithmetic types, strings, vectors (or lists) of supported types, and pairs
+// and tuples of supported types. A file is a header (a magic number and the type fingerprint),
+// then the blocks of all the values, children before their parents, and finally the slot of the
+// root value. A slot is 8 bytes: arithmetic values are stored in it directly, everything else as
+// the offset of its block from the start of the file.
+//  - string: its length, then its bytes and a '\0';
+//  - vector of an arithmetic type: its size and the offset of its elements, which are stored
+//    contiguously, 64-byte aligned so that they can be loaded with aligned SIMD instructions;
+//  - other vectors: their size, then a table of the slots of their elements;
+//  - pair or tuple: the slots of its elements.
+// Values use the byte order of the machine that wrote them.
+//
+// FlatFile maps such a file and hands out accessors: flat_t<T> is T itself for arithmetic types,
+// std::string_view for strings, and FlatView<T> otherwise. Arithmetic elements can be updated in
+// place through a writable mapping, which updates the file itself. try_root only checks the header
+// and the offset of the root block; the offsets inside blocks are trusted, so only files written by
+// serialize_flat should be opened.
+
+namespace serializer {
+  namespace binary {
+    template <typename T>
+    class FlatView;
+
+    namespace {
+      template <typename T>
+      struct FlatAccess {
+        using type = FlatView<T>;
+      };
+      template <>
+      struct FlatAccess<string> {
+        using type = std::string_view;
+      };
+    } // namespace
+    template <typename T>
+    using flat_t = std::conditional_t<std::is_arithmetic_v<T>, T, typename FlatAccess<T>::type>;
+
+    // declarations
+    template <typename T>
+    void serialize_flat(const T &t, std::ostream &os);
+    template <typename T>
+    void serialize_flat(const T &t, const string &file_name);
+
+    namespace {
+      constexpr char flat_magic[8] = {'S', 'E', 'R', 'F', 'L', 'A', 'T', '1'};
+      constexpr size_t flat_alignment = 64;
+      constexpr size_t flat_slot_size = sizeof(uint64_t);
+      // the magic number and the fingerprint
+      constexpr size_t flat_header_size = sizeof(flat_magic) + sizeof(uint64_t);
+
+      // Keeps track of the offset, so that any ostream will do.
+      class FlatWriter {
+      public:
+        explicit FlatWriter(std::ostream &os) : os_(os) {}
+        uint64_t pos() const { return pos_; }
+        void write(const void *p, size_t size) {
+          os_.write(static_cast<const char *>(p), size);
+          pos_ += size;
+        }
+        void write_slot(uint64_t slot) { write(&slot, sizeof(slot)); }
+        void align(size_t alignment) {
+          static const char zeros[flat_alignment] = {};
+          if (pos_ % alignment != 0) {
+            write(zeros, alignment - pos_ % alignment);
+          }
+        }
+
+      private:
+        std::ostream &os_;
+        uint64_t pos_ = 0;
+      };
+
+      template <typename T>
+      uint64_t _write_flat(FlatWriter &w, const T &t);
+
+      template <typename T, size_t... I>
+      uint64_t _write_flat_record(FlatWriter &w, const T &t, std::index_sequence<I...>) {
+        const uint64_t slots[] = {_write_flat(w, std::get<I>(t))...};
+        w.align(flat_slot_size);
+        const uint64_t offset = w.pos();
+        w.write(slots, sizeof(slots));
+        return offset;
+      }
+
+      // Writes the blocks of t, and returns its slot.
+      template <typename T>
+      uint64_t _write_flat(FlatWriter &w, const T &t) {
+        TRACE("_write_flat(FlatWriter& w, const T& t)");
+        if constexpr (std::is_arithmetic_v<T>) {
+          static_assert(sizeof(T) <= flat_slot_size, "T must fit in a slot");
+          uint64_t slot = 0;
+          memcpy(&slot, &t, sizeof(t));
+          return slot;
+        } else if constexpr (is_same_v<remove_cv_t<T>, string>) {
+          w.align(flat_slot_size);
+          const uint64_t offset = w.pos();
+          w.write_slot(t.size());
+          w.write(t.c_str(), t.size() + 1);
+          return offset;
+        } else if constexpr (is_array_container_v<T>) {
+          static_assert(!is_bool_vector_v<T>, "std::vector<bool> is not stored contiguously");
+          using E = typename T::value_type;
+          if constexpr (std::is_arithmetic_v<E>) {
+            w.align(flat_alignment);
+            const uint64_t data = w.pos();
+            if constexpr (is_same_v<T, std::vector<E, typename T::allocator_type>>) {
+              w.write(t.data(), t.size() * sizeof(E));
+            } else {
+              for (const E &elem : t) {
+                w.write(&elem, sizeof(elem));
+              }
+            }
+            w.align(flat_slot_size);
+            const uint64_t offset = w.pos();
+            w.write_slot(t.size());
+            w.write_slot(data);
+            return offset;
+          } else {
+            std::vector<uint64_t> slots;
+            slots.reserve(t.size());
+            for (const E &elem : t) {
+              slots.push_back(_write_flat(w, elem));
+            }
+            w.align(flat_slot_size);
+            const uint64_t offset = w.pos();
+            w.write_slot(t.size());
+            w.write(slots.data(), slots.size() * sizeof(uint64_t));
+            return offset;
+          }
+        } else if constexpr (is_pair_v<T> || is_tuple_v<T>) {
+          return _write_flat_record(w, t, std::make_index_sequence<std::tuple_size_v<T>>{});
+        } else {
+          static_assert(always_false<T>, "T is not supported by the flat layout");
+        }
+      }
+
+      inline uint64_t _flat_slot(const char *base, uint64_t offset) {
+        uint64_t slot;
+        memcpy(&slot, base + offset, sizeof(slot));
+        return slot;
+      }
+
+      template <typename T>
+      flat_t<T> _flat_get(char *base, uint64_t slot) {
+        if constexpr (std::is_arithmetic_v<T>) {
+          T t;
+          memcpy(&t, &slot, sizeof(t));
+          return t;
+        } else if constexpr (is_same_v<T, string>) {
+          return std::string_view(base + slot + flat_slot_size, _flat_slot(base, slot));
+        } else {
+          return FlatView<T>(base, slot);
+        }
+      }
+    } // namespace
+
+    // Accessor of a pair or a tuple.
+    template <typename T>
+    class FlatView {
+    public:
+      static_assert(is_pair_v<T> || is_tuple_v<T>, "T is not supported by the flat layout");
+      template <size_t I>
+      using element_t = remove_cv_t<std::tuple_element_t<I, T>>;
+
+      FlatView() = default;
+      FlatView(char *base, uint64_t offset) : base_(base), offset_(offset) {}
+
+      template <size_t I>
+      flat_t<element_t<I>> get() const {
+        return _flat_get<element_t<I>>(base_, _flat_slot(base_, offset_ + I * flat_slot_size));
+      }
+      // Updates an arithmetic element in place.
+      template <size_t I>
+      void set(element_t<I> value) {
+        static_assert(std::is_arithmetic_v<element_t<I>>, "only arithmetic elements can be updated in place");
+        memcpy(base_ + offset_ + I * flat_slot_size, &value, sizeof(value));
+      }
+
+    private:
+      char *base_ = nullptr;
+      uint64_t offset_ = 0;
+    };
+
+    // Accessor of a vector, or of a list written as one.
+    template <typename E, typename Alloc>
+    class FlatView<std::vector<E, Alloc>> {
+    public:
+      FlatView() = default;
+      FlatView(char *base, uint64_t offset) : base_(base), offset_(offset) {}
+
+      size_t size() const { return _flat_slot(base_, offset_); }
+      bool empty() const { return size() == 0; }
+      flat_t<E> operator[](size_t i) const {
+        if constexpr (std::is_arithmetic_v<E>) {
+          return data()[i];
+        } else {
+          return _flat_get<E>(base_, _flat_slot(base_, offset_ + (i + 1) * flat_slot_size));
+        }
+      }
+
+      // The elements of an arithmetic vector, 64-byte aligned.
+      E *data() const {
+        static_assert(std::is_arithmetic_v<E>, "only arithmetic elements are stored contiguously");
+        return reinterpret_cast<E *>(base_ + _flat_slot(base_, offset_ + flat_slot_size));
+      }
+      E *begin() const { return data(); }
+      E *end() const { return data() + size(); }
+      // Updates an arithmetic element in place.
+      void set(size_t i, E value) { data()[i] = value; }
+
+    private:
+      char *base_ = nullptr;
+      uint64_t offset_ = 0;
+    };
+    template <typename E, typename Alloc>
+    class FlatView<std::list<E, Alloc>> : public FlatView<std::vector<E>> {
+      using FlatView<std::vector<E>>::FlatView;
+    };
+
+    // A file in the flat layout, memory-mapped where the platform supports it, and read into an
+    // aligned buffer otherwise (in which case in-place updates do not reach the file).
+    class FlatFile {
+    public:
+      FlatFile() = default;
+      ~FlatFile() { close(); }
+      FlatFile(const FlatFile &) = delete;
+      FlatFile &operator=(const FlatFile &) = delete;
+
+      // A writable mapping is shared, so other processes mapping the file see the updates.
+      DecodeResult open(const string &file_name, bool writable = false) {
+        TRACE("FlatFile::open(const string &file_name, bool writable)");
+        close();
+#if SERIALIZER_FLAT_MMAP
+        const int fd = ::open(file_name.c_str(), writable ? O_RDWR : O_RDONLY);
+        if (fd < 0) {
+          return DecodeResult{DecodeErrc::open_failed, 0};
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+          ::close(fd);
+          return DecodeResult{DecodeErrc::open_failed, 0};
+        }
+        size_ = st.st_size;
+        if (size_ >= flat_header_size + flat_slot_size) {
+          void *p = mmap(nullptr, size_, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+          data_ = p == MAP_FAILED ? nullptr : static_cast<char *>(p);
+        }
+        ::close(fd);
+#else
+        std::ifstream is(file_name, std::ios::binary | std::ios::ate);
+        if (!is.good()) {
+          return DecodeResult{DecodeErrc::open_failed, 0};
+        }
+        size_ = is.tellg();
+        if (size_ >= flat_header_size + flat_slot_size) {
+          data_ = static_cast<char *>(::operator new(size_, std::align_val_t(flat_alignment)));
+          is.seekg(0);
+          is.read(data_, size_);
+        }
+#endif
+        if (size_ < flat_header_size + flat_slot_size) {
+          close();
+          return DecodeResult{DecodeErrc::truncated, 0};
+        }
+        if (data_ == nullptr) {
+          close();
+          return DecodeResult{DecodeErrc::open_failed, 0};
+        }
+        if (memcmp(data_, flat_magic, sizeof(flat_magic)) != 0) {
+          close();
+          return DecodeResult{DecodeErrc::size_mismatch, 0};
+        }
+        return DecodeResult{};
+      }
+      void close() {
+        if (data_ != nullptr) {
+#if SERIALIZER_FLAT_MMAP
+          munmap(data_, size_);
+#else
+          ::operator delete(data_, std::align_val_t(flat_alignment));
+#endif
+        }
+        data_ = nullptr;
+        size_ = 0;
+      }
+      // Writes the in-place updates back to the file.
+      void flush() {
+#if SERIALIZER_FLAT_MMAP
+        if (data_ != nullptr) {
+          msync(data_, size_, MS_SYNC);
+        }
+#endif
+      }
+
+      char *data() const { return data_; }
+      size_t size() const { return size_; }
+      uint64_t fingerprint() const { return _flat_slot(data_, sizeof(flat_magic)); }
+
+      template <typename T>
+      DecodeResult try_root(flat_t<T> &root) const {
+        TRACE("FlatFile::try_root(flat_t<T>& root)");
+        if (data_ == nullptr) {
+          return DecodeResult{DecodeErrc::open_failed, 0};
+        }
+        if (fingerprint() != type_fingerprint_v<T>) {
+          return DecodeResult{DecodeErrc::fingerprint_mismatch, sizeof(flat_magic)};
+        }
+        const uint64_t slot = _flat_slot(data_, size_ - flat_slot_size);
+        if constexpr (!std::is_arithmetic_v<T>) {
+          // the first slot of the root block lies between the header and the root slot
+          if (slot < flat_header_size || slot > size_ - 2 * flat_slot_size) {
+            return DecodeResult{DecodeErrc::truncated, size_ - flat_slot_size};
+          }
+        }
+        root = _flat_get<T>(data_, slot);
+        return DecodeResult{};
+      }
+      template <typename T>
+      flat_t<T> root() const {
+        TRACE("FlatFile::root()");
+        flat_t<T> root;
+        _throw_if_failed(try_root<T>(root));
+        return root;
+      }
+
+    private:
+      char *data_ = nullptr;
+      size_t size_ = 0;
+    };
+
+    // definitions
+    template <typename T>
+    void serialize_flat(const T &t, std::ostream &os) {
+      TRACE("serialize_flat(const T& t, std::ostream& os)");
+      FlatWriter w(os);
+      w.write(flat_magic, sizeof(flat_magic));
+      w.write_slot(type_fingerprint_v<T>);
+      const uint64_t root = _write_flat(w, t);
+      w.align(flat_slot_size);
+      w.write_slot(root);
+      // Check that the writes succeeded.
+      ASSERT(os.good());
+    }
+    template <typename T>
+    void serialize_flat(const T &t, const string &file_name) {
+      TRACE("serialize_flat(const T& t, const string &file_name)");
+      std::ofstream os(file_name, std::ios::binary);
+      // Check if file is opened successfully
+      ASSERT(os.good());
+      serialize_flat(t, os);
+      os.close();
+    }
+  } // namespace binary
+} // namespace serializer
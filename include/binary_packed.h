@@ -0,0 +1,295 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "common.h"
+#include "errors.h"
+#include "libbinary.h"
+#include "type_utils.h"
+
+// Packed encoding for maps and sets whose keys and values are arithmetic.
+//
+// Layout: element count, then the keys block and (for maps) the values block, each prefixed with
+// its size in bytes. Integral keys are delta coded in iteration order, and every delta is stored
+// as a zigzag LEB128 varint, so densely packed ids take one byte each. Floating point and bool
+// keys, as well as all values, are stored as raw arrays.
+//
+// Ordered containers are written in iteration order, which is sorted, so that loading appends each
+// element at the end of the tree in O(1) instead of searching for its position. Unordered
+// containers are sorted first, only to make the deltas small.
+
+namespace serializer {
+  // Check if a type is a map or set container with arithmetic keys (and values).
+  namespace {
+    // fallback struct:
+    template <typename T, typename U = void>
+    struct PK {
+      static constexpr bool v = false;
+    };
+    template <typename T>
+    struct PK<T, std::enable_if_t<is_map_container_v<T>>> {
+      static constexpr bool v =
+          std::is_arithmetic_v<typename T::key_type> && std::is_arithmetic_v<typename T::mapped_type>;
+    };
+    template <typename T>
+    struct PK<T, std::enable_if_t<is_set_container_v<T>>> {
+      static constexpr bool v = std::is_arithmetic_v<typename T::key_type>;
+    };
+
+    // Ordered containers expose their comparator as key_compare.
+    template <typename T, typename U = void>
+    struct OC {
+      static constexpr bool v = false;
+    };
+    template <typename T>
+    struct OC<T, std::void_t<typename T::key_compare>> {
+      static constexpr bool v = true;
+    };
+  } // namespace
+  template <typename T>
+  constexpr auto is_packable_container_v = PK<remove_cv_t<T>>::v;
+  template <typename T>
+  constexpr auto is_ordered_container_v = OC<remove_cv_t<T>>::v;
+
+  namespace binary {
+    // declarations
+    template <typename T>
+    void serialize_packed(const T &t, std::ostream &os);
+    template <typename T>
+    void serialize_packed(const T &t, const string &file_name);
+
+    template <typename T>
+    void deserialize_packed(T &t, std::istream &is);
+    template <typename T>
+    void deserialize_packed(T &t, const string &file_name);
+
+    namespace {
+      template <typename K>
+      constexpr bool is_delta_coded_v = std::is_integral_v<K> && !is_same_v<remove_cv_t<K>, bool>;
+
+      inline void _put_varint(string &buf, uint64_t v) {
+        while (v >= 0x80) {
+          buf.push_back(static_cast<char>((v & 0x7f) | 0x80));
+          v >>= 7;
+        }
+        buf.push_back(static_cast<char>(v));
+      }
+      // Returns false if the varint runs past `end` or is longer than 64 bits.
+      inline bool _get_varint(const unsigned char *&p, const unsigned char *end, uint64_t &v) {
+        v = 0;
+        for (unsigned shift = 0; shift < 64 && p < end; shift += 7) {
+          const unsigned char byte = *p++;
+          v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+          if ((byte & 0x80) == 0) {
+            return true;
+          }
+        }
+        return false;
+      }
+
+      // Integral keys are widened to uint64_t, so that the difference of two keys wraps around
+      // instead of overflowing, and can be undone exactly. Signed keys are sign-extended, so that
+      // small steps across zero stay small deltas. Decoding truncates, which undoes either widening.
+      template <typename K>
+      uint64_t _widen(K k) {
+        if constexpr (std::is_signed_v<K>) {
+          return static_cast<uint64_t>(static_cast<int64_t>(k));
+        } else {
+          return static_cast<uint64_t>(k);
+        }
+      }
+      inline uint64_t _zigzag(uint64_t delta) {
+        const int64_t d = static_cast<int64_t>(delta);
+        return (static_cast<uint64_t>(d) << 1) ^ static_cast<uint64_t>(d >> 63);
+      }
+      inline uint64_t _unzigzag(uint64_t z) { return (z >> 1) ^ (~(z & 1) + 1); }
+
+      template <typename K, typename Iter, typename GetKey>
+      string _encode_keys(Iter begin, Iter end, size_t count, GetKey get_key) {
+        string buf;
+        if constexpr (is_delta_coded_v<K>) {
+          buf.reserve(count);
+          uint64_t prev = 0;
+          for (Iter it = begin; it != end; ++it) {
+            const uint64_t cur = _widen<K>(get_key(*it));
+            _put_varint(buf, _zigzag(cur - prev));
+            prev = cur;
+          }
+        } else {
+          buf.resize(count * sizeof(K));
+          char *out = buf.data();
+          for (Iter it = begin; it != end; ++it) {
+            const K k = get_key(*it);
+            memcpy(out, &k, sizeof(K));
+            out += sizeof(K);
+          }
+        }
+        return buf;
+      }
+
+      template <typename K>
+      DecodeErrc _decode_keys(const string &buf, size_t count, std::unique_ptr<K[]> &keys) {
+        // The count is checked against the block before anything is allocated for it: a varint
+        // takes at least one byte, and other keys exactly sizeof(K).
+        if constexpr (is_delta_coded_v<K>) {
+          if (count > buf.size()) {
+            return DecodeErrc::truncated;
+          }
+        } else {
+          if (buf.size() % sizeof(K) != 0 || buf.size() / sizeof(K) != count) {
+            return DecodeErrc::size_mismatch;
+          }
+        }
+        keys.reset(new K[count]);
+        if constexpr (is_delta_coded_v<K>) {
+          const unsigned char *p = reinterpret_cast<const unsigned char *>(buf.data());
+          const unsigned char *end = p + buf.size();
+          uint64_t prev = 0;
+          for (size_t i = 0; i < count; i++) {
+            uint64_t z;
+            if (!_get_varint(p, end, z)) {
+              return DecodeErrc::truncated;
+            }
+            prev += _unzigzag(z);
+            keys[i] = static_cast<K>(static_cast<std::make_unsigned_t<K>>(prev));
+          }
+          if (p != end) {
+            return DecodeErrc::size_mismatch;
+          }
+        } else {
+          memcpy(keys.get(), buf.data(), buf.size());
+        }
+        return DecodeErrc::ok;
+      }
+
+      template <typename T>
+      DecodeErrc _deserialize_packed(T &t, std::istream &is, size_t &offset) {
+        TRACE("_deserialize_packed(T& t, std::istream& is, size_t& offset)");
+        using K = typename T::key_type;
+        DepthGuard depth_guard;
+        RETURN_IF_ERROR(depth_guard.status());
+        size_t count;
+        // at least one byte per key, plus the bookkeeping of a node
+        RETURN_IF_ERROR(_read_length(is, count, offset, is_delta_coded_v<K> ? 1 : sizeof(K),
+                                     sizeof(typename T::value_type) + 4 * sizeof(void *)));
+        const size_t start = offset;
+        // each block is read with a single read() of its size-prefixed bytes
+        string buf;
+        RETURN_IF_ERROR(_read(is, buf, offset));
+        std::unique_ptr<K[]> keys;
+        const DecodeErrc e = _decode_keys<K>(buf, count, keys);
+        if (e != DecodeErrc::ok) {
+          offset = start;
+          return e;
+        }
+        t.clear();
+        if constexpr (!is_ordered_container_v<T>) {
+          t.reserve(count);
+        }
+        if constexpr (is_map_container_v<T>) {
+          using V = typename T::mapped_type;
+          const size_t values_start = offset;
+          RETURN_IF_ERROR(_read(is, buf, offset));
+          if (buf.size() != count * sizeof(V)) {
+            offset = values_start;
+            return DecodeErrc::size_mismatch;
+          }
+          const char *values = buf.data();
+          for (size_t i = 0; i < count; i++) {
+            V v;
+            memcpy(&v, values + i * sizeof(V), sizeof(V));
+            // Keys come in the container's own order, so the end is always the right hint.
+            t.emplace_hint(t.end(), keys[i], v);
+          }
+        } else {
+          for (size_t i = 0; i < count; i++) {
+            t.emplace_hint(t.end(), keys[i]);
+          }
+        }
+        return DecodeErrc::ok;
+      }
+    } // namespace
+
+    // definitions
+    template <typename T>
+    void serialize_packed(const T &t, std::ostream &os) {
+      TRACE("serialize_packed(const T& t, std::ostream& os)");
+      static_assert(is_packable_container_v<T>, "T must be a map or set with arithmetic keys and values");
+      using K = typename T::key_type;
+      const size_t count = t.size();
+      _write(os, count, sizeof(count));
+      auto get_key = [](const auto &elem) -> K {
+        if constexpr (is_map_container_v<T>) {
+          return elem.first;
+        } else {
+          return elem;
+        }
+      };
+      if constexpr (is_ordered_container_v<T>) {
+        _write(os, _encode_keys<K>(t.begin(), t.end(), count, get_key));
+        if constexpr (is_map_container_v<T>) {
+          using V = typename T::mapped_type;
+          string values(count * sizeof(V), '\0');
+          size_t i = 0;
+          for (const auto &elem : t) {
+            memcpy(&values[i++ * sizeof(V)], &elem.second, sizeof(V));
+          }
+          _write(os, values);
+        }
+      } else {
+        // Sort pointers to the elements, so that the deltas between consecutive keys are small.
+        std::vector<const typename T::value_type *> sorted;
+        sorted.reserve(count);
+        for (const auto &elem : t) {
+          sorted.push_back(&elem);
+        }
+        std::sort(sorted.begin(), sorted.end(), [&](auto a, auto b) { return get_key(*a) < get_key(*b); });
+        _write(os, _encode_keys<K>(sorted.begin(), sorted.end(), count, [&](auto p) { return get_key(*p); }));
+        if constexpr (is_map_container_v<T>) {
+          using V = typename T::mapped_type;
+          string values(count * sizeof(V), '\0');
+          for (size_t i = 0; i < count; i++) {
+            memcpy(&values[i * sizeof(V)], &sorted[i]->second, sizeof(V));
+          }
+          _write(os, values);
+        }
+      }
+      ASSERT(os.good());
+    }
+    template <typename T>
+    void serialize_packed(const T &t, const string &file_name) {
+      TRACE("serialize_packed(const T& t, const string &file_name)");
+      std::ofstream os(file_name, std::ios::binary);
+      // Check if file is opened successfully
+      ASSERT(os.good());
+      serialize_packed(t, os);
+      os.close();
+    }
+
+    template <typename T>
+    void deserialize_packed(T &t, std::istream &is) {
+      TRACE("deserialize_packed(T& t, std::istream& is)");
+      static_assert(is_packable_container_v<T>, "T must be a map or set with arithmetic keys and values");
+      DecodeResult r;
+      r.code = _deserialize_packed(t, is, r.offset);
+      _throw_if_failed(r);
+    }
+    template <typename T>
+    void deserialize_packed(T &t, const string &file_name) {
+      TRACE("deserialize_packed(T& t, const string &file_name)");
+      std::ifstream is(file_name, std::ios::binary);
+      // Check if file exists
+      ASSERT(is.good());
+      deserialize_packed(t, is);
+    }
+  } // namespace binary
+} // namespace serializer
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "binary_packed.h"
+#include "common.h"
+#include "errors.h"
+#include "fingerprint.h"
+#include "libbinary.h"
+#include "thread_pool.h"
+#include "type_utils.h"
+
+// Sharded encoding for large maps and sets.
+//
+// The elements are hash-partitioned by key into N shard files, `<base>.0` to `<base>.<N-1>`, which
+// are written and read in parallel on serializer::thread_pool(). Each shard holds its elements in
+// the regular encoding of T, so a single shard can also be read with deserialize. The manifest,
+// `<base>.manifest`, holds the type fingerprint of T and the number of elements of each shard.
+//
+// These wait for tasks of the pool, so they must not be called from one of its threads.
+
+namespace serializer {
+  namespace binary {
+    // declarations
+    template <typename T>
+    void serialize_sharded(const T &t, const string &base_name, size_t shards);
+
+    template <typename T>
+    void deserialize_sharded(T &t, const string &base_name);
+    // Exception-free variant of deserialize_sharded. The offset is relative to the start of the
+    // manifest or shard that failed.
+    template <typename T>
+    DecodeResult try_deserialize_sharded(T &t, const string &base_name);
+
+    namespace {
+      // fingerprint of T, and the number of elements of each shard
+      using ShardManifest = std::tuple<uint64_t, std::vector<size_t>>;
+
+      inline string _shard_file_name(const string &base_name, size_t shard) {
+        return base_name + "." + std::to_string(shard);
+      }
+      inline string _manifest_file_name(const string &base_name) { return base_name + ".manifest"; }
+
+      template <typename T>
+      const auto &_shard_key(const typename T::value_type &elem) {
+        if constexpr (is_map_container_v<T>) {
+          return elem.first;
+        } else {
+          return elem;
+        }
+      }
+
+      template <typename T>
+      void _write_shard(const std::vector<const typename T::value_type *> &elems, const string &file_name) {
+        TRACE("_write_shard(const std::vector<const typename T::value_type *>& elems, const string& file_name)");
+        std::ofstream os(file_name, std::ios::binary);
+        // Check if file is opened successfully
+        ASSERT(os.good());
+        // One identity table for the whole shard, as deserialize uses when reading it back as a T.
+        [[maybe_unused]] pointer_scope_t<T> pointer_scope;
+        // the same layout as serialize(T)
+        const size_t size = elems.size();
+        _write(os, size, sizeof(size));
+        for (const auto *elem : elems) {
+          if constexpr (is_map_container_v<T>) {
+            serialize(elem->first, os);
+            serialize(elem->second, os);
+          } else {
+            serialize(*elem, os);
+          }
+        }
+        os.close();
+        ASSERT(!os.fail());
+      }
+    } // namespace
+
+    // definitions
+    template <typename T>
+    void serialize_sharded(const T &t, const string &base_name, size_t shards) {
+      TRACE("serialize_sharded(const T& t, const string &base_name, size_t shards)");
+      static_assert(is_map_container_v<T> || is_set_container_v<T>, "T must be a map or set container");
+      ASSERT(shards > 0);
+      using K = remove_cv_t<typename T::key_type>;
+      std::vector<std::vector<const typename T::value_type *>> partitions(shards);
+      for (auto &partition : partitions) {
+        partition.reserve(t.size() / shards + 1);
+      }
+      const std::hash<K> hash;
+      for (const auto &elem : t) {
+        partitions[hash(_shard_key<T>(elem)) % shards].push_back(&elem);
+      }
+      std::vector<std::future<void>> writes;
+      writes.reserve(shards);
+      for (size_t i = 0; i < shards; i++) {
+        writes.push_back(thread_pool().submit(
+            [&partitions, &base_name, i] { _write_shard<T>(partitions[i], _shard_file_name(base_name, i)); }));
+      }
+      // Wait for every shard before rethrowing the first failure, since they refer to t.
+      for (auto &write : writes) {
+        write.wait();
+      }
+      for (auto &write : writes) {
+        write.get();
+      }
+      ShardManifest manifest{type_fingerprint_v<T>, {}};
+      for (const auto &partition : partitions) {
+        std::get<1>(manifest).push_back(partition.size());
+      }
+      // The manifest is written last, so that it only exists once all the shards do.
+      serialize(manifest, _manifest_file_name(base_name));
+    }
+
+    template <typename T>
+    DecodeResult try_deserialize_sharded(T &t, const string &base_name) {
+      TRACE("try_deserialize_sharded(T& t, const string &base_name)");
+      static_assert(is_map_container_v<T> || is_set_container_v<T>, "T must be a map or set container");
+      ShardManifest manifest;
+      DecodeResult r = try_deserialize(manifest, _manifest_file_name(base_name));
+      if (!r) {
+        return r;
+      }
+      if (std::get<0>(manifest) != type_fingerprint_v<T>) {
+        return DecodeResult{DecodeErrc::fingerprint_mismatch, 0};
+      }
+      const std::vector<size_t> &counts = std::get<1>(manifest);
+      std::vector<T> shards(counts.size());
+      std::vector<std::future<DecodeResult>> reads;
+      reads.reserve(counts.size());
+      for (size_t i = 0; i < counts.size(); i++) {
+        reads.push_back(thread_pool().submit(
+            [&shards, &base_name, i] { return try_deserialize(shards[i], _shard_file_name(base_name, i)); }));
+      }
+      std::vector<DecodeResult> results;
+      results.reserve(reads.size());
+      for (auto &read : reads) {
+        results.push_back(read.get());
+      }
+      size_t total = 0;
+      for (size_t i = 0; i < counts.size(); i++) {
+        if (!results[i]) {
+          return results[i];
+        }
+        if (shards[i].size() != counts[i]) {
+          return DecodeResult{DecodeErrc::size_mismatch, 0};
+        }
+        total += counts[i];
+      }
+      t.clear();
+      if constexpr (!is_ordered_container_v<T>) {
+        t.reserve(total);
+      }
+      // Splices the nodes over, rather than copying the elements.
+      for (T &shard : shards) {
+        t.merge(shard);
+      }
+      return DecodeResult{};
+    }
+    template <typename T>
+    void deserialize_sharded(T &t, const string &base_name) {
+      TRACE("deserialize_sharded(T& t, const string &base_name)");
+      _throw_if_failed(try_deserialize_sharded(t, base_name));
+    }
+  } // namespace binary
+} // namespace serializer
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "binary_packed.h"
+#include "common.h"
+#include "errors.h"
+#include "libbinary.h"
+#include "type_utils.h"
+
+// Lengths-then-blob encoding for array containers of strings.
+//
+// Layout: element count, then the lengths of all strings as one block of varints, then all the
+// strings concatenated into one blob. Decoding takes two bulk reads, and builds every string
+// straight from the blob.
+
+namespace serializer {
+  // Check if a type is an array container of std::string or std::string_view.
+  namespace {
+    // fallback struct:
+    template <typename T, bool = is_array_container_v<T>>
+    struct SA {
+      static constexpr bool v = false;
+    };
+    template <typename T>
+    struct SA<T, true> {
+      static constexpr bool v = std::is_same_v<typename T::value_type, string> ||
+                                std::is_same_v<typename T::value_type, std::string_view>;
+    };
+  } // namespace
+  template <typename T>
+  constexpr auto is_string_array_v = SA<remove_cv_t<T>>::v;
+
+  namespace binary {
+    // declarations
+    template <typename T>
+    void serialize_string_array(const T &t, std::ostream &os);
+    template <typename T>
+    void serialize_string_array(const T &t, const string &file_name);
+
+    template <typename T>
+    void deserialize_string_array(T &t, std::istream &is);
+    template <typename T>
+    void deserialize_string_array(T &t, const string &file_name);
+    // Loads views into `blob`, which receives the concatenated strings and must outlive t.
+    template <typename T>
+    void deserialize_string_array(T &t, string &blob, std::istream &is);
+    template <typename T>
+    void deserialize_string_array(T &t, string &blob, const string &file_name);
+
+    namespace {
+      template <typename T>
+      DecodeErrc _deserialize_string_array(T &t, string &blob, std::istream &is, size_t &offset) {
+        TRACE("_deserialize_string_array(T& t, string& blob, std::istream& is, size_t& offset)");
+        DepthGuard depth_guard;
+        RETURN_IF_ERROR(depth_guard.status());
+        size_t count;
+        // at least one byte for a length
+        RETURN_IF_ERROR(_read_length(is, count, offset, 1, sizeof(typename T::value_type)));
+        const size_t lengths_start = offset;
+        string lengths;
+        RETURN_IF_ERROR(_read(is, lengths, offset));
+        RETURN_IF_ERROR(_read(is, blob, offset));
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(lengths.data());
+        const unsigned char *end = p + lengths.size();
+        // every length takes at least one byte, so the count is checked before t is resized to it
+        if (count > lengths.size()) {
+          offset = lengths_start;
+          return DecodeErrc::size_mismatch;
+        }
+        t.clear();
+        t.resize(count);
+        size_t pos = 0;
+        for (auto &elem : t) {
+          uint64_t length;
+          if (!_get_varint(p, end, length) || length > blob.size() - pos) {
+            offset = lengths_start;
+            return DecodeErrc::size_mismatch;
+          }
+          if constexpr (std::is_same_v<typename T::value_type, std::string_view>) {
+            elem = std::string_view(blob.data() + pos, length);
+          } else {
+            elem.assign(blob, pos, length);
+          }
+          pos += length;
+        }
+        if (p != end || pos != blob.size()) {
+          offset = lengths_start;
+          return DecodeErrc::size_mismatch;
+        }
+        return DecodeErrc::ok;
+      }
+    } // namespace
+
+    // definitions
+    template <typename T>
+    void serialize_string_array(const T &t, std::ostream &os) {
+      TRACE("serialize_string_array(const T& t, std::ostream& os)");
+      static_assert(is_string_array_v<T>, "T must be a vector or list of strings");
+      const size_t count = t.size();
+      _write(os, count, sizeof(count));
+      string lengths;
+      lengths.reserve(count);
+      size_t total = 0;
+      for (const auto &elem : t) {
+        _put_varint(lengths, elem.size());
+        total += elem.size();
+      }
+      _write(os, lengths);
+      // Same encoding as one string of all the elements, but without concatenating them first.
+      os.write(reinterpret_cast<const char *>(&total), sizeof(total));
+      for (const auto &elem : t) {
+        os.write(elem.data(), elem.size());
+      }
+      ASSERT(os.good());
+    }
+    template <typename T>
+    void serialize_string_array(const T &t, const string &file_name) {
+      TRACE("serialize_string_array(const T& t, const string &file_name)");
+      std::ofstream os(file_name, std::ios::binary);
+      // Check if file is opened successfully
+      ASSERT(os.good());
+      serialize_string_array(t, os);
+      os.close();
+    }
+
+    template <typename T>
+    void deserialize_string_array(T &t, std::istream &is) {
+      TRACE("deserialize_string_array(T& t, std::istream& is)");
+      static_assert(is_string_array_v<T> && std::is_same_v<typename T::value_type, string>,
+                    "T must be a vector or list of std::string; loading views requires a blob");
+      string blob;
+      DecodeResult r;
+      r.code = _deserialize_string_array(t, blob, is, r.offset);
+      _throw_if_failed(r);
+    }
+    template <typename T>
+    void deserialize_string_array(T &t, const string &file_name) {
+      TRACE("deserialize_string_array(T& t, const string &file_name)");
+      std::ifstream is(file_name, std::ios::binary);
+      // Check if file exists
+      ASSERT(is.good());
+      deserialize_string_array(t, is);
+    }
+    template <typename T>
+    void deserialize_string_array(T &t, string &blob, std::istream &is) {
+      TRACE("deserialize_string_array(T& t, string& blob, std::istream& is)");
+      static_assert(is_string_array_v<T>, "T must be a vector or list of strings");
+      DecodeResult r;
+      r.code = _deserialize_string_array(t, blob, is, r.offset);
+      _throw_if_failed(r);
+    }
+    template <typename T>
+    void deserialize_string_array(T &t, string &blob, const string &file_name) {
+      TRACE("deserialize_string_array(T& t, string& blob, const string &file_name)");
+      std::ifstream is(file_name, std::ios::binary);
+      // Check if file exists
+      ASSERT(is.good());
+      deserialize_string_array(t, blob, is);
+    }
+  } // namespace binary
+} // namespace serializer
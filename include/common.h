@@ -1,8 +1,31 @@
 #pragma once
 
+// Without exceptions (e.g. -fno-exceptions), failed assertions abort instead. Use the try_*
+// entry points to handle malformed input without exceptions.
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS)
 #define ASSERT(a) \
   do { \
     if (!(a)) { \
       throw std::runtime_error("Assertion failed: " #a); \
     } \
   } while(0);
+
+#define FAIL(message) throw std::runtime_error(message)
+#else
+#include <cstdio>
+#include <cstdlib>
+
+#define ASSERT(a) \
+  do { \
+    if (!(a)) { \
+      std::fputs("Assertion failed: " #a "\n", stderr); \
+      std::abort(); \
+    } \
+  } while(0);
+
+#define FAIL(message) \
+  do { \
+    std::fprintf(stderr, "%s\n", std::string(message).c_str()); \
+    std::abort(); \
+  } while(0)
+#endif
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <string>
+
+#include "errors.h"
+
+namespace serializer {
+  // Resource limits for decoding untrusted input. Every length read from the input is checked
+  // against these limits, and against the number of bytes left in the input, before anything is
+  // allocated for it. A violation fails the decode like any other malformed input: deserialize
+  // throws, and try_deserialize returns the matching DecodeErrc.
+  struct DecodeLimits {
+    // Upper bound of the bytes allocated for containers and strings during one decode. Node-based
+    // containers are charged an estimate of their per-node size.
+    size_t max_total_allocation = size_t(1) << 30;
+    // Maximum number of elements of any single container.
+    size_t max_container_length = size_t(1) << 28;
+    // Maximum length of any single string.
+    size_t max_string_length = size_t(1) << 28;
+    // Maximum nesting depth of containers and user-defined types.
+    size_t max_depth = 64;
+  };
+
+  // Decoding state shared by all the nested calls of one bounded decode.
+  class DecodeContext {
+  public:
+    explicit DecodeContext(const DecodeLimits &limits) : limits_(limits) {}
+
+    // `min_encoded_size` is the smallest number of bytes one element can take in the input, and
+    // `element_size` the number of bytes one element takes in memory.
+    DecodeErrc check_container(std::istream &is, size_t length, size_t min_encoded_size, size_t element_size) {
+      if (length > limits_.max_container_length) {
+        return DecodeErrc::container_too_long;
+      }
+      if (length > remaining(is) / min_encoded_size) {
+        return DecodeErrc::length_exceeds_input;
+      }
+      return charge(length, element_size);
+    }
+    DecodeErrc check_string(std::istream &is, size_t length) {
+      if (length > limits_.max_string_length) {
+        return DecodeErrc::string_too_long;
+      }
+      if (length > remaining(is)) {
+        return DecodeErrc::length_exceeds_input;
+      }
+      return charge(length, 1);
+    }
+    // Every enter() must be paired with a leave(), even if enter() fails.
+    DecodeErrc enter() { return ++depth_ <= limits_.max_depth ? DecodeErrc::ok : DecodeErrc::depth_limit; }
+    void leave() { depth_--; }
+
+    size_t allocated() const { return allocated_; }
+
+  private:
+    DecodeErrc charge(size_t count, size_t size) {
+      if (size != 0 && count > (limits_.max_total_allocation - allocated_) / size) {
+        return DecodeErrc::allocation_limit;
+      }
+      allocated_ += count * size;
+      return DecodeErrc::ok;
+    }
+    // Bytes left in `is`, or SIZE_MAX if the stream is not seekable. The end offset is cached for
+    // the last stream seen, since nested user-defined types are decoded from their own streams.
+    size_t remaining(std::istream &is) {
+      const std::streamoff pos = is.tellg();
+      if (pos < 0) {
+        return SIZE_MAX;
+      }
+      if (&is != stream_) {
+        is.seekg(0, std::ios::end);
+        end_ = is.tellg();
+        is.seekg(pos);
+        stream_ = &is;
+      }
+      return end_ > pos ? static_cast<size_t>(end_ - pos) : 0;
+    }
+
+    DecodeLimits limits_;
+    size_t allocated_ = 0;
+    size_t depth_ = 0;
+    const std::istream *stream_ = nullptr;
+    std::streamoff end_ = 0;
+  };
+
+  // The context of the bounded decode running on this thread, or nullptr if there is none. This is
+  // not in an anonymous namespace, so that user-defined types compiled in other translation units
+  // still decode under the same limits.
+  inline DecodeContext *&current_decode_context() {
+    thread_local DecodeContext *ctx = nullptr;
+    return ctx;
+  }
+
+  // Installs a DecodeContext for the lifetime of this object.
+  class DecodeScope {
+  public:
+    explicit DecodeScope(const DecodeLimits &limits) : ctx_(limits), prev_(current_decode_context()) {
+      current_decode_context() = &ctx_;
+    }
+    ~DecodeScope() { current_decode_context() = prev_; }
+    DecodeScope(const DecodeScope &) = delete;
+    DecodeScope &operator=(const DecodeScope &) = delete;
+
+  private:
+    DecodeContext ctx_;
+    DecodeContext *prev_;
+  };
+
+  // Tracks nesting depth while a container or user-defined type is being decoded. Check status()
+  // right after construction.
+  class DepthGuard {
+  public:
+    DepthGuard() : ctx_(current_decode_context()) {
+      if (ctx_ != nullptr) {
+        status_ = ctx_->enter();
+      }
+    }
+    ~DepthGuard() {
+      if (ctx_ != nullptr) {
+        ctx_->leave();
+      }
+    }
+    DepthGuard(const DepthGuard &) = delete;
+    DepthGuard &operator=(const DepthGuard &) = delete;
+
+    DecodeErrc status() const { return status_; }
+
+  private:
+    DecodeContext *ctx_;
+    DecodeErrc status_ = DecodeErrc::ok;
+  };
+} // namespace serializer
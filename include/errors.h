@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+
+namespace serializer {
+  // Error codes of the try_* decoding entry points.
+  enum class DecodeErrc {
+    ok = 0,
+    // The file could not be opened, or the XML could not be parsed.
+    open_failed,
+    // The input ended, or the stream failed, before the value was complete.
+    truncated,
+    // A size prefix does not match the type being decoded.
+    size_mismatch,
+    // An XML element or attribute that the type requires is missing.
+    missing_node,
+    // An XML attribute could not be parsed as the expected literal.
+    bad_literal,
+    // DecodeLimits violations, see decode_limits.h.
+    container_too_long,
+    string_too_long,
+    length_exceeds_input,
+    allocation_limit,
+    depth_limit,
+    // The type fingerprint in the header does not match the type being decoded.
+    fingerprint_mismatch,
+    // A patch operation does not fit the object it is applied to.
+    patch_mismatch,
+    // The decoder threw, e.g. a user-defined type rejecting its input, or an allocation failing.
+    // Only reported by the callback variants of the *_async entry points, which cannot rethrow.
+    exception_thrown,
+  };
+
+  inline const char *decode_errc_message(DecodeErrc e) {
+    switch (e) {
+    case DecodeErrc::ok:
+      return "ok";
+    case DecodeErrc::open_failed:
+      return "failed to open or parse the input";
+    case DecodeErrc::truncated:
+      return "input is truncated";
+    case DecodeErrc::size_mismatch:
+      return "size prefix does not match the type";
+    case DecodeErrc::missing_node:
+      return "required element or attribute is missing";
+    case DecodeErrc::bad_literal:
+      return "malformed literal";
+    case DecodeErrc::container_too_long:
+      return "container length exceeds max_container_length";
+    case DecodeErrc::string_too_long:
+      return "string length exceeds max_string_length";
+    case DecodeErrc::length_exceeds_input:
+      return "length exceeds the remaining input";
+    case DecodeErrc::allocation_limit:
+      return "allocation exceeds max_total_allocation";
+    case DecodeErrc::depth_limit:
+      return "nesting exceeds max_depth";
+    case DecodeErrc::fingerprint_mismatch:
+      return "type fingerprint does not match";
+    case DecodeErrc::patch_mismatch:
+      return "patch does not apply to the object";
+    case DecodeErrc::exception_thrown:
+      return "an exception was thrown while decoding";
+    }
+    return "unknown error";
+  }
+
+  // Result of serializer::binary::try_deserialize.
+  struct DecodeResult {
+    DecodeErrc code = DecodeErrc::ok;
+    // Byte offset of the field that failed to decode, relative to where decoding started.
+    size_t offset = 0;
+
+    explicit operator bool() const { return code == DecodeErrc::ok; }
+  };
+
+  // Result of serializer::xml::try_deserialize_xml.
+  struct XMLDecodeResult {
+    DecodeErrc code = DecodeErrc::ok;
+    // '/'-separated element names leading to the node that failed, e.g. "serialization/v/_3".
+    // Truncated to fit, so that reporting an error never allocates.
+    char path[256] = {};
+
+    explicit operator bool() const { return code == DecodeErrc::ok; }
+  };
+} // namespace serializer
+
+// Returns the DecodeErrc of `expr` from the enclosing function, unless it is DecodeErrc::ok.
+#define RETURN_IF_ERROR(expr) \
+  do { \
+    const ::serializer::DecodeErrc _decode_errc = (expr); \
+    if (_decode_errc != ::serializer::DecodeErrc::ok) { \
+      return _decode_errc; \
+    } \
+  } while (0)
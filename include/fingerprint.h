@@ -0,0 +1,207 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "common.h"
+#include "errors.h"
+#include "libbinary.h"
+#include "type_utils.h"
+
+// Structural type fingerprints, computed at compile time from the same traits the binary format
+// dispatches on. Two types have the same fingerprint if they are encoded the same way: e.g.
+// std::vector<int> and std::list<int> match, while std::vector<int> and std::vector<long> don't.
+//
+// User-defined types are opaque to the library. They may declare their own fingerprint as
+//   static constexpr uint64_t fingerprint = ...;
+// and bump it whenever their encoding changes. Otherwise, all BinSerializable types share one
+// fingerprint.
+
+namespace serializer {
+  namespace {
+    // fallback struct:
+    template <typename T, typename U = void>
+    struct FP {
+      static constexpr bool v = false;
+    };
+    template <typename T>
+    struct FP<T, std::void_t<decltype(T::fingerprint)>> {
+      static constexpr bool v = std::is_convertible_v<decltype(T::fingerprint), uint64_t>;
+    };
+
+    // Tokens that tell the kinds of types apart.
+    enum class FingerprintTag : uint64_t {
+      boolean = 1,
+      signed_integer,
+      unsigned_integer,
+      floating_point,
+      string,
+      bits,
+      bitset,
+      pair,
+      tuple,
+      sequence,
+      map,
+      set,
+      shared_ptr,
+      unique_ptr,
+      user_defined,
+    };
+
+    // FNV-1a over the bytes of v.
+    constexpr uint64_t _fingerprint_mix(uint64_t h, uint64_t v) {
+      for (int i = 0; i < 8; i++) {
+        h ^= (v >> (8 * i)) & 0xff;
+        h *= 0x100000001b3ULL;
+      }
+      return h;
+    }
+    constexpr uint64_t _fingerprint_mix(uint64_t h, FingerprintTag tag) {
+      return _fingerprint_mix(h, static_cast<uint64_t>(tag));
+    }
+
+    template <typename T>
+    constexpr uint64_t _fingerprint(uint64_t h);
+    template <typename Tuple, size_t... I>
+    constexpr uint64_t _tuple_fingerprint(uint64_t h, std::index_sequence<I...>) {
+      ((h = _fingerprint<std::tuple_element_t<I, Tuple>>(h)), ...);
+      return h;
+    }
+
+    template <typename T>
+    constexpr uint64_t _fingerprint(uint64_t h) {
+      using U = remove_cv_t<T>;
+      if constexpr (std::is_same_v<U, bool>) {
+        return _fingerprint_mix(h, FingerprintTag::boolean);
+      } else if constexpr (std::is_arithmetic_v<U>) {
+        const FingerprintTag tag = std::is_floating_point_v<U> ? FingerprintTag::floating_point
+                                   : std::is_signed_v<U>       ? FingerprintTag::signed_integer
+                                                               : FingerprintTag::unsigned_integer;
+        return _fingerprint_mix(_fingerprint_mix(h, tag), sizeof(U));
+      } else if constexpr (is_string_cstring_v<T>) {
+        // C-style strings are stored as strings
+        return _fingerprint_mix(h, FingerprintTag::string);
+      } else if constexpr (is_bool_vector_v<U>) {
+        return _fingerprint_mix(h, FingerprintTag::bits);
+      } else if constexpr (is_bitset_v<U>) {
+        return _fingerprint_mix(_fingerprint_mix(h, FingerprintTag::bitset), U().size());
+      } else if constexpr (is_pair_v<U>) {
+        h = _fingerprint_mix(h, FingerprintTag::pair);
+        return _fingerprint<typename U::second_type>(_fingerprint<typename U::first_type>(h));
+      } else if constexpr (is_tuple_v<U>) {
+        h = _fingerprint_mix(_fingerprint_mix(h, FingerprintTag::tuple), std::tuple_size_v<U>);
+        return _tuple_fingerprint<U>(h, std::make_index_sequence<std::tuple_size_v<U>>{});
+      } else if constexpr (is_array_container_v<U>) {
+        return _fingerprint<typename U::value_type>(_fingerprint_mix(h, FingerprintTag::sequence));
+      } else if constexpr (is_map_container_v<U>) {
+        h = _fingerprint_mix(h, FingerprintTag::map);
+        return _fingerprint<typename U::mapped_type>(_fingerprint<typename U::key_type>(h));
+      } else if constexpr (is_set_container_v<U>) {
+        return _fingerprint<typename U::value_type>(_fingerprint_mix(h, FingerprintTag::set));
+      } else if constexpr (is_shared_ptr_v<U>) {
+        return _fingerprint<typename U::element_type>(_fingerprint_mix(h, FingerprintTag::shared_ptr));
+      } else if constexpr (is_unique_ptr_v<U>) {
+        return _fingerprint<typename U::element_type>(_fingerprint_mix(h, FingerprintTag::unique_ptr));
+      } else if constexpr (FP<U>::v) {
+        return _fingerprint_mix(_fingerprint_mix(h, FingerprintTag::user_defined), static_cast<uint64_t>(U::fingerprint));
+      } else if constexpr (is_base_of_v<binary::BinSerializable, U>) {
+        return _fingerprint_mix(h, FingerprintTag::user_defined);
+      } else {
+        static_assert(always_false<T>, "T is not a supported type, it has no fingerprint");
+      }
+    }
+  } // namespace
+
+  // The fingerprint of T's binary encoding.
+  template <typename T>
+  constexpr uint64_t type_fingerprint_v = _fingerprint<T>(0xcbf29ce484222325ULL);
+
+  namespace binary {
+    // declarations
+    // Writes type_fingerprint_v<T> before t, so that readers can check the type first.
+    template <typename T>
+    void serialize_with_fingerprint(const T &t, std::ostream &os);
+    template <typename T>
+    void serialize_with_fingerprint(const T &t, const string &file_name);
+
+    // Fail with DecodeErrc::fingerprint_mismatch, without reading past the header, if the file was
+    // written with a different type.
+    template <typename T>
+    void deserialize_with_fingerprint(T &t, std::istream &is);
+    template <typename T>
+    void deserialize_with_fingerprint(T &t, const string &file_name);
+    template <typename T>
+    DecodeResult try_deserialize_with_fingerprint(T &t, std::istream &is);
+    template <typename T>
+    DecodeResult try_deserialize_with_fingerprint(T &t, const string &file_name);
+
+    // Reads only the fingerprint written by serialize_with_fingerprint, e.g. to key a cache on it.
+    inline DecodeResult read_fingerprint(uint64_t &fingerprint, std::istream &is);
+
+    // definitions
+    template <typename T>
+    void serialize_with_fingerprint(const T &t, std::ostream &os) {
+      TRACE("serialize_with_fingerprint(const T& t, std::ostream& os)");
+      constexpr uint64_t fingerprint = type_fingerprint_v<T>;
+      _write(os, fingerprint, sizeof(fingerprint));
+      serialize(t, os);
+    }
+    template <typename T>
+    void serialize_with_fingerprint(const T &t, const string &file_name) {
+      TRACE("serialize_with_fingerprint(const T& t, const string &file_name)");
+      std::ofstream os(file_name, std::ios::binary);
+      // Check if file is opened successfully
+      ASSERT(os.good());
+      serialize_with_fingerprint(t, os);
+      os.close();
+    }
+
+    inline DecodeResult read_fingerprint(uint64_t &fingerprint, std::istream &is) {
+      TRACE("read_fingerprint(uint64_t& fingerprint, std::istream& is)");
+      DecodeResult r;
+      r.code = _read(is, fingerprint, r.offset);
+      return r;
+    }
+
+    template <typename T>
+    DecodeResult try_deserialize_with_fingerprint(T &t, std::istream &is) {
+      TRACE("try_deserialize_with_fingerprint(T& t, std::istream& is)");
+      uint64_t fingerprint;
+      DecodeResult r = read_fingerprint(fingerprint, is);
+      if (!r) {
+        return r;
+      }
+      if (fingerprint != type_fingerprint_v<T>) {
+        return DecodeResult{DecodeErrc::fingerprint_mismatch, 0};
+      }
+      DecodeResult body = try_deserialize(t, is);
+      body.offset += r.offset;
+      return body;
+    }
+    template <typename T>
+    DecodeResult try_deserialize_with_fingerprint(T &t, const string &file_name) {
+      TRACE("try_deserialize_with_fingerprint(T& t, const string &file_name)");
+      std::ifstream is(file_name, std::ios::binary);
+      // Check if file exists
+      if (!is.good()) {
+        return DecodeResult{DecodeErrc::open_failed, 0};
+      }
+      return try_deserialize_with_fingerprint(t, is);
+    }
+    template <typename T>
+    void deserialize_with_fingerprint(T &t, std::istream &is) {
+      TRACE("deserialize_with_fingerprint(T& t, std::istream& is)");
+      _throw_if_failed(try_deserialize_with_fingerprint(t, is));
+    }
+    template <typename T>
+    void deserialize_with_fingerprint(T &t, const string &file_name) {
+      TRACE("deserialize_with_fingerprint(T& t, const string &file_name)");
+      _throw_if_failed(try_deserialize_with_fingerprint(t, file_name));
+    }
+  } // namespace binary
+} // namespace serializer
@@ -1,19 +1,28 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
 #include <fstream>
 #include <initializer_list>
 #include <iostream>
 #include <list>
 #include <map>
+#include <memory>
 #include <set>
 #include <stdexcept>
 #include <string>
 #include <type_traits>
+#include <typeinfo>
+#include <utility>
 #include <variant>
 #include <vector>
 
 #include "common.h"
+#include "decode_limits.h"
+#include "errors.h"
+#include "metrics.h"
+#include "pointer_table.h"
 #include "type_utils.h"
 
 using std::is_base_of_v;
@@ -50,15 +59,17 @@ namespace serializer {
       void _write(std::ostream &os, const T &t);
       void _write(std::ostream &os, const std::string &s);
 
+      // `offset` counts the bytes consumed so far. On failure, it is left at the start of the field
+      // that failed to decode.
       template <typename T>
-      void _read(std::istream &is, T &t);
+      DecodeErrc _read(std::istream &is, T &t, size_t &offset);
       // No need to pass in the str's size, since we've stored the size of the string we're reading.
-      void _read(std::istream &is, std::string &str);
+      DecodeErrc _read(std::istream &is, std::string &str, size_t &offset);
 
       // definitions
       template <typename T>
       void _write(std::ostream &os, const T &t, size_t size) {
-        _debug("_write(std::ostream& os, const T& t, size_t size)");
+        TRACE("_write(std::ostream& os, const T& t, size_t size)");
         static_assert(!is_array_container_v<T>, "T must not be a container");
         // strings are handled separately
         static_assert(!is_same_v<remove_cv_t<T>, std::string>, "T must not be a string");
@@ -73,7 +84,7 @@ namespace serializer {
       }
       template <typename T>
       void _write(std::ostream &os, const T &t) {
-        _debug("_write(std::ostream& os, const T& t)");
+        TRACE("_write(std::ostream& os, const T& t)");
         static_assert(!is_array_container_v<T>, "T must not be a container");
         static_assert(!is_same_v<remove_cv_t<T>, std::string>, "T must not be a string");
         const size_t size = sizeof(t);
@@ -81,7 +92,7 @@ namespace serializer {
         os.write(reinterpret_cast<const char *>(&t), size);
       }
       inline void _write(std::ostream &os, const std::string &s) {
-        _debug("_write(std::ostream& os, const std::string& s)");
+        TRACE("_write(std::ostream& os, const std::string& s)");
         // we can't use sizeof(s.c_str()), because the string might contain null characters
         size_t size = s.size();
         _write(os, s.c_str(), size);
@@ -89,27 +100,163 @@ namespace serializer {
 
       // If T is a pointer type, then t should be pre-allocated.
       template <typename T>
-      void _read(std::istream &is, T &t) {
-        _debug("_read(std::istream& is, T& t)");
+      DecodeErrc _read(std::istream &is, T &t, size_t &offset) {
+        TRACE("_read(std::istream& is, T& t, size_t& offset)");
         static_assert(!is_array_container_v<T>, "T must not be a container");
         static_assert(!is_same_v<remove_cv_t<T>, std::string>, "T must not be a string");
         size_t size;
-        is.read(reinterpret_cast<char *>(&size), sizeof(size));
+        if (!is.read(reinterpret_cast<char *>(&size), sizeof(size))) {
+          return DecodeErrc::truncated;
+        }
         if constexpr (std::is_pointer_v<T>) {
           is.read(reinterpret_cast<char *>(t), size);
         } else {
+          // A corrupted size would otherwise overflow t.
+          if (size != sizeof(t)) {
+            return DecodeErrc::size_mismatch;
+          }
           is.read(reinterpret_cast<char *>(&t), size);
         }
+        if (!is) {
+          return DecodeErrc::truncated;
+        }
+        offset += sizeof(size) + size;
+        return DecodeErrc::ok;
       }
-      inline void _read(std::istream &is, std::string &str) {
-        _debug("_read(std::istream& is, std::string& str)");
+      inline DecodeErrc _read(std::istream &is, std::string &str, size_t &offset) {
+        TRACE("_read(std::istream& is, std::string& str, size_t& offset)");
         size_t size;
-        is.read(reinterpret_cast<char *>(&size), sizeof(size));
-        char *c_str = new char[size]; // +1 for null terminator
-        is.read(c_str, size);
-        ASSERT(is.good());
-        str = string(c_str, size);
-        delete[] c_str;
+        if (!is.read(reinterpret_cast<char *>(&size), sizeof(size))) {
+          return DecodeErrc::truncated;
+        }
+        if (DecodeContext *ctx = current_decode_context()) {
+          RETURN_IF_ERROR(ctx->check_string(is, size));
+        }
+        // read straight into the string, without a temporary buffer
+        str.resize(size);
+        is.read(str.data(), size);
+        if (!is) {
+          return DecodeErrc::truncated;
+        }
+        offset += sizeof(size) + size;
+        return DecodeErrc::ok;
+      }
+      // Reads a container length, and checks it against the DecodeLimits in effect, if any.
+      inline DecodeErrc _read_length(std::istream &is, size_t &size, size_t &offset, size_t min_encoded_size,
+                                     size_t element_size) {
+        const size_t start = offset;
+        RETURN_IF_ERROR(_read(is, size, offset));
+        if (DecodeContext *ctx = current_decode_context()) {
+          const DecodeErrc e = ctx->check_container(is, size, min_encoded_size, element_size);
+          if (e != DecodeErrc::ok) {
+            offset = start;
+            return e;
+          }
+        }
+        return DecodeErrc::ok;
+      }
+
+      // std::vector<bool> and std::bitset are stored as their number of bits, followed by the bits
+      // packed into 64-bit words, least significant bit first. Unused bits of the last word are 0.
+      using bit_word = uint64_t;
+      constexpr size_t bits_per_word = 64;
+      // Words are copied through a buffer of this many words on the stack.
+      constexpr size_t bit_buffer_words = 256;
+
+      // Returns the words holding the bits of t if the standard library lays them out exactly like
+      // the encoding does, so that they can be copied whole, or nullptr otherwise.
+      template <typename T>
+      auto _bit_storage(T &t) {
+        using word_ptr = std::conditional_t<std::is_const_v<T>, const bit_word *, bit_word *>;
+#if defined(__GLIBCXX__)
+        // libstdc++ stores both in arrays of unsigned long, least significant bit first.
+        if constexpr (sizeof(unsigned long) == sizeof(bit_word)) {
+          if constexpr (is_bitset_v<T>) {
+            return reinterpret_cast<word_ptr>(&t);
+          } else {
+            return reinterpret_cast<word_ptr>(t.begin()._M_p);
+          }
+        }
+#endif
+        return static_cast<word_ptr>(nullptr);
+      }
+
+      template <typename T>
+      void _write_bits(std::ostream &os, const T &t) {
+        TRACE("_write_bits(std::ostream& os, const T& t)");
+        const size_t bits = t.size();
+        _write(os, bits, sizeof(bits));
+        const size_t words = (bits + bits_per_word - 1) / bits_per_word;
+        const bit_word *storage = _bit_storage(t);
+        bit_word buf[bit_buffer_words];
+        for (size_t w = 0; w < words; w += bit_buffer_words) {
+          const size_t n = std::min(bit_buffer_words, words - w);
+          if (storage != nullptr) {
+            memcpy(buf, storage + w, n * sizeof(bit_word));
+          } else {
+            for (size_t k = 0; k < n; k++) {
+              const size_t first = (w + k) * bits_per_word;
+              const size_t last = std::min(first + bits_per_word, bits);
+              bit_word word = 0;
+              for (size_t i = first; i < last; i++) {
+                word |= static_cast<bit_word>(t[i]) << (i - first);
+              }
+              buf[k] = word;
+            }
+          }
+          if (w + n == words && bits % bits_per_word != 0) {
+            buf[n - 1] &= (bit_word(1) << (bits % bits_per_word)) - 1;
+          }
+          os.write(reinterpret_cast<const char *>(buf), n * sizeof(bit_word));
+        }
+        ASSERT(os.good());
+      }
+
+      template <typename T>
+      DecodeErrc _read_bits(std::istream &is, T &t, size_t &offset) {
+        TRACE("_read_bits(std::istream& is, T& t, size_t& offset)");
+        const size_t start = offset;
+        size_t bits;
+        RETURN_IF_ERROR(_read(is, bits, offset));
+        const size_t words = (bits + bits_per_word - 1) / bits_per_word;
+        if constexpr (is_bitset_v<T>) {
+          if (bits != t.size()) {
+            offset = start;
+            return DecodeErrc::size_mismatch;
+          }
+        } else {
+          if (DecodeContext *ctx = current_decode_context()) {
+            const DecodeErrc e = ctx->check_container(is, words, sizeof(bit_word), sizeof(bit_word));
+            if (e != DecodeErrc::ok) {
+              offset = start;
+              return e;
+            }
+          }
+          t.resize(bits);
+        }
+        if (bit_word *storage = _bit_storage(t)) {
+          // straight into the container, in a single read
+          if (!is.read(reinterpret_cast<char *>(storage), words * sizeof(bit_word))) {
+            return DecodeErrc::truncated;
+          }
+          // std::bitset relies on its unused bits being 0
+          if (bits % bits_per_word != 0) {
+            storage[words - 1] &= (bit_word(1) << (bits % bits_per_word)) - 1;
+          }
+        } else {
+          bit_word buf[bit_buffer_words];
+          for (size_t w = 0; w < words; w += bit_buffer_words) {
+            const size_t n = std::min(bit_buffer_words, words - w);
+            if (!is.read(reinterpret_cast<char *>(buf), n * sizeof(bit_word))) {
+              return DecodeErrc::truncated;
+            }
+            for (size_t i = w * bits_per_word; i < std::min((w + n) * bits_per_word, bits); i++) {
+              t[i] = (buf[i / bits_per_word - w] >> (i % bits_per_word)) & 1;
+            }
+          }
+        }
+        offset += words * sizeof(bit_word);
+        return DecodeErrc::ok;
       }
     } // namespace
 
@@ -123,33 +270,233 @@ namespace serializer {
     void deserialize(T &t, std::istream &is);
     template <typename T>
     void deserialize(T &t, const string &file_name);
+    template <typename T>
+    void deserialize(T &t, std::istream &is, const DecodeLimits &limits);
+    template <typename T>
+    void deserialize(T &t, const string &file_name, const DecodeLimits &limits);
+
+    // Exception-free variants of deserialize. On failure, they return the error and the byte offset
+    // where decoding stopped, and t is left partially decoded.
+    template <typename T>
+    DecodeResult try_deserialize(T &t, std::istream &is);
+    template <typename T>
+    DecodeResult try_deserialize(T &t, const string &file_name);
+    template <typename T>
+    DecodeResult try_deserialize(T &t, std::istream &is, const DecodeLimits &limits);
+    template <typename T>
+    DecodeResult try_deserialize(T &t, const string &file_name, const DecodeLimits &limits);
+
+    namespace {
+      // Whether a T may hold shared_ptrs, in which case serialize and _deserialize install a
+      // PointerTable for it. User-defined types are opaque, so they are assumed to hold some.
+      template <typename T>
+      constexpr bool _may_hold_pointers();
+      template <typename Tuple, size_t... I>
+      constexpr bool _tuple_may_hold_pointers(std::index_sequence<I...>) {
+        return (_may_hold_pointers<std::tuple_element_t<I, Tuple>>() || ...);
+      }
+      template <typename T>
+      constexpr bool _may_hold_pointers() {
+        if constexpr (is_shared_ptr_v<T> || is_base_of_v<BinSerializable, remove_cv_t<T>>) {
+          return true;
+        } else if constexpr (is_unique_ptr_v<T>) {
+          return _may_hold_pointers<typename T::element_type>();
+        } else if constexpr (is_pair_v<T>) {
+          return _may_hold_pointers<typename T::first_type>() || _may_hold_pointers<typename T::second_type>();
+        } else if constexpr (is_tuple_v<T>) {
+          return _tuple_may_hold_pointers<remove_cv_t<T>>(std::make_index_sequence<std::tuple_size_v<T>>{});
+        } else if constexpr (is_map_container_v<T>) {
+          return _may_hold_pointers<typename T::key_type>() || _may_hold_pointers<typename T::mapped_type>();
+        } else if constexpr (is_array_container_v<T> || is_set_container_v<T>) {
+          return _may_hold_pointers<typename T::value_type>();
+        } else {
+          return false;
+        }
+      }
+
+      // Stands in for PointerScope where no table is needed.
+      struct _NoPointerScope {};
+      template <typename T>
+      using pointer_scope_t = std::conditional_t<_may_hold_pointers<T>(), PointerScope, _NoPointerScope>;
+    } // namespace
+
+    namespace {
+      // The decoder behind both deserialize and try_deserialize.
+      template <typename T>
+      DecodeErrc _deserialize(T &t, std::istream &is, size_t &offset) {
+        TRACE("_deserialize(T& t, std::istream& is, size_t& offset)");
+        [[maybe_unused]] pointer_scope_t<T> pointer_scope;
+        if constexpr (is_supported_container_v<T>) {
+          TRACE("is_supported_container_v<T>");
+          DepthGuard depth_guard;
+          RETURN_IF_ERROR(depth_guard.status());
+          if constexpr (is_pair_v<T>) {
+            TRACE("_deserialize: is_pair_v<T>");
+            typename T::first_type first;
+            typename T::second_type second;
+            RETURN_IF_ERROR(_deserialize(first, is, offset));
+            RETURN_IF_ERROR(_deserialize(second, is, offset));
+            t = std::make_pair(std::move(first), std::move(second));
+          } else if constexpr (is_bool_vector_v<T>) {
+            TRACE("_deserialize: is_bool_vector_v<T>");
+            return _read_bits(is, t, offset);
+          } else if constexpr (is_array_container_v<T>) {
+            TRACE("_deserialize: is_array_container_v<T>");
+            size_t size;
+            RETURN_IF_ERROR(_read_length(is, size, offset, sizeof(size_t), sizeof(typename T::value_type)));
+            TRACE("_deserialize: resizing to %zu", size);
+            t.resize(size);
+            for (auto &elem : t) {
+              // here we use the reference to the element in the container
+              // because std::list does not support operator[]
+              RETURN_IF_ERROR(_deserialize(elem, is, offset));
+            }
+          } else if constexpr (is_tuple_v<T>) {
+            TRACE("_deserialize: is_tuple_v<T>");
+            const size_t start = offset;
+            size_t size = std::tuple_size_v<T>;
+            RETURN_IF_ERROR(_read(is, size, offset));
+            if (size != std::tuple_size_v<T>) {
+              offset = start;
+              return DecodeErrc::size_mismatch;
+            }
+            // Here we use foreach_in_tuple to iterate over the elements of the tuple at
+            // compile time, since std::get<i> is constexpr after C++14.
+            DecodeErrc e = DecodeErrc::ok;
+            foreach_in_tuple(t, [&](auto &elem, auto) {
+              if (e == DecodeErrc::ok) {
+                e = _deserialize(elem, is, offset);
+              }
+            });
+            return e;
+          } else if constexpr (is_map_container_v<T>) {
+            TRACE("_deserialize: is_map_container_v<T>");
+            size_t size;
+            // a key and a value, plus the bookkeeping of a node
+            RETURN_IF_ERROR(_read_length(is, size, offset, 2 * sizeof(size_t),
+                                         sizeof(typename T::value_type) + 4 * sizeof(void *)));
+            for (size_t i = 0; i < size; ++i) {
+              typename T::key_type key;
+              typename T::mapped_type value;
+              RETURN_IF_ERROR(_deserialize(key, is, offset));
+              RETURN_IF_ERROR(_deserialize(value, is, offset));
+              t.insert(std::make_pair(std::move(key), std::move(value)));
+            }
+          } else if constexpr (is_set_container_v<T>) {
+            TRACE("_deserialize: is_set_container_v<T>");
+            size_t size;
+            RETURN_IF_ERROR(
+                _read_length(is, size, offset, sizeof(size_t), sizeof(typename T::value_type) + 4 * sizeof(void *)));
+            for (size_t i = 0; i < size; ++i) {
+              typename T::value_type value;
+              RETURN_IF_ERROR(_deserialize(value, is, offset));
+              t.insert(std::move(value));
+            }
+          } else {
+            static_assert(always_false<T>, "T is a supported container type, but it's serializer is missing.");
+          }
+          return DecodeErrc::ok;
+        } else if constexpr (is_supported_literal_v<T>) {
+          if constexpr (is_cstring_v<T>) {
+            // Reading a string in this case, because we are storing char* as strings.
+            string s;
+            RETURN_IF_ERROR(_read(is, s, offset));
+            // The user should preallocate enough spaces for C-style strings.
+            memcpy(t, s.c_str(), s.size());
+            return DecodeErrc::ok;
+          } else {
+            return _read(is, t, offset);
+          }
+        } else if constexpr (is_bitset_v<T>) {
+          TRACE("_deserialize: is_bitset_v<T>");
+          return _read_bits(is, t, offset);
+        } else if constexpr (is_shared_ptr_v<T> || is_unique_ptr_v<T>) {
+          TRACE("_deserialize: is_shared_ptr_v<T> || is_unique_ptr_v<T>");
+          using E = std::remove_const_t<typename T::element_type>;
+          const size_t start = offset;
+          size_t ref;
+          RETURN_IF_ERROR(_read(is, ref, offset));
+          if (ref == PointerTable::null_ref) {
+            t.reset();
+            return DecodeErrc::ok;
+          }
+          if constexpr (is_shared_ptr_v<T>) {
+            PointerTable &table = *current_pointer_table();
+            if (ref == PointerTable::new_ref) {
+              // Registered before its contents are decoded, so that cycles back to it resolve.
+              std::shared_ptr<E> p = std::make_shared<E>();
+              table.read.emplace_back(p, &typeid(E));
+              t = p;
+              return _deserialize(*p, is, offset);
+            }
+            const size_t id = ref - PointerTable::back_ref;
+            if (id >= table.read.size() || *table.read[id].second != typeid(E)) {
+              offset = start;
+              return DecodeErrc::size_mismatch;
+            }
+            t = std::static_pointer_cast<E>(table.read[id].first);
+            return DecodeErrc::ok;
+          } else {
+            if (ref != PointerTable::new_ref) {
+              offset = start;
+              return DecodeErrc::size_mismatch;
+            }
+            std::unique_ptr<E> p = std::make_unique<E>();
+            RETURN_IF_ERROR(_deserialize(*p, is, offset));
+            t = std::move(p);
+            return DecodeErrc::ok;
+          }
+        } else if constexpr (is_base_of_v<BinSerializable, remove_cv_t<T>>) {
+          TRACE("_deserialize: is_base_of_v<BinSerializable, remove_cv_t<T>>");
+          DepthGuard depth_guard;
+          RETURN_IF_ERROR(depth_guard.status());
+          string s;
+          RETURN_IF_ERROR(_read(is, s, offset));
+          t.deserializeFromString(s);
+          return DecodeErrc::ok;
+        } else {
+          static_assert(always_false<T>, "T is not a supported type, you must provide a deserialize function");
+        }
+      }
+
+      inline void _throw_if_failed(const DecodeResult &r) {
+        if (!r) {
+          FAIL(string("deserialize: ") + decode_errc_message(r.code) + " at byte " + std::to_string(r.offset));
+        }
+      }
+    } // namespace
 
     // definitions
     template <typename T>
     void serialize(const T &t, std::ostream &os) {
-      _debug("serialize(const T& t, std::ostream& os)");
+      TRACE("serialize(const T& t, std::ostream& os)");
+      METRICS_SCOPE(T, metrics::Op::serialize, os);
+      [[maybe_unused]] pointer_scope_t<T> pointer_scope;
       if constexpr (is_supported_container_v<T>) {
-        _debug("is_supported_container_v<T>");
+        TRACE("is_supported_container_v<T>");
         if constexpr (is_pair_v<T>) {
-          _debug("serialize: is_pair_v<T>");
+          TRACE("serialize: is_pair_v<T>");
           serialize(t.first, os);
           serialize(t.second, os);
+        } else if constexpr (is_bool_vector_v<T>) {
+          TRACE("serialize: is_bool_vector_v<T>");
+          _write_bits(os, t);
         } else if constexpr (is_array_container_v<T>) {
-          _debug("serialize: is_array_container_v<T>");
+          TRACE("serialize: is_array_container_v<T>");
           size_t size = t.size();
           _write(os, size, sizeof(size));
           for (const auto &elem : t) {
             serialize(elem, os);
           }
         } else if constexpr (is_tuple_v<T>) {
-          _debug("serialize: is_tuple_v<T>");
+          TRACE("serialize: is_tuple_v<T>");
           constexpr size_t size = std::tuple_size_v<T>;
           _write(os, size, sizeof(size));
           // Here we use foreach_in_tuple to iterate over the elements of the tuple at
           // compile time, since std::get<i> is constexpr after C++14.
           foreach_in_tuple(t, [&](const auto &elem, auto) { serialize(elem, os); });
         } else if constexpr (is_map_container_v<T>) {
-          _debug("serialize: is_map_container_v<T>");
+          TRACE("serialize: is_map_container_v<T>");
           size_t size = t.size();
           _write(os, size, sizeof(size));
           for (const auto &elem : t) {
@@ -157,7 +504,7 @@ namespace serializer {
             serialize(elem.second, os);
           }
         } else if constexpr (is_set_container_v<T>) {
-          _debug("serialize: is_set_container_v<T>");
+          TRACE("serialize: is_set_container_v<T>");
           size_t size = t.size();
           _write(os, size, sizeof(size));
           for (const auto &elem : t) {
@@ -173,8 +520,31 @@ namespace serializer {
         } else {
           _write(os, t);
         }
+      } else if constexpr (is_bitset_v<T>) {
+        TRACE("serialize: is_bitset_v<T>");
+        _write_bits(os, t);
+      } else if constexpr (is_shared_ptr_v<T>) {
+        TRACE("serialize: is_shared_ptr_v<T>");
+        PointerTable &table = *current_pointer_table();
+        size_t ref = PointerTable::null_ref;
+        if (t) {
+          auto [it, inserted] = table.written.emplace(t.get(), table.written.size());
+          ref = inserted ? PointerTable::new_ref : PointerTable::back_ref + it->second;
+        }
+        _write(os, ref, sizeof(ref));
+        if (ref == PointerTable::new_ref) {
+          serialize(*t, os);
+        }
+      } else if constexpr (is_unique_ptr_v<T>) {
+        TRACE("serialize: is_unique_ptr_v<T>");
+        // A unique_ptr is never shared, so it needs no id.
+        const size_t ref = t ? PointerTable::new_ref : PointerTable::null_ref;
+        _write(os, ref, sizeof(ref));
+        if (t) {
+          serialize(*t, os);
+        }
       } else if constexpr (is_base_of_v<BinSerializable, remove_cv_t<T>>) {
-        _debug("serialize: is_base_of_v<BinSerializable, remove_cv_t<T>>");
+        TRACE("serialize: is_base_of_v<BinSerializable, remove_cv_t<T>>");
         string s = t.serializeToString();
         serialize(s, os);
       } else {
@@ -183,7 +553,7 @@ namespace serializer {
     }
     template <typename T>
     void serialize(const T &t, const string &file_name) {
-      _debug("serialize(const T& t, const string &file_name)");
+      TRACE("serialize(const T& t, const string &file_name)");
       std::ofstream os(file_name, std::ios::binary);
       // Check if file is opened successfully
       ASSERT(os.good());
@@ -193,85 +563,54 @@ namespace serializer {
 
     template <typename T>
     void deserialize(T &t, std::istream &is) {
-      _debug("deserialize(T& t, std::istream& is)");
-      if constexpr (is_supported_container_v<T>) {
-        _debug("is_supported_container_v<T>");
-        if constexpr (is_pair_v<T>) {
-          _debug("deserialize: is_pair_v<T>");
-          typename T::first_type first;
-          typename T::second_type second;
-          deserialize(first, is);
-          deserialize(second, is);
-          t = std::make_pair(first, second);
-        } else if constexpr (is_array_container_v<T>) {
-          _debug("deserialize: is_array_container_v<T>");
-          size_t size;
-          _read(is, size);
-          _debug("deserialize: resizing to " + std::to_string(size));
-          t.resize(size);
-          for (auto &elem : t) {
-            // here we use the reference to the element in the container
-            // because std::list does not support operator[]
-            deserialize(elem, is);
-          }
-        } else if constexpr (is_tuple_v<T>) {
-          _debug("deserialize: is_tuple_v<T>");
-          size_t size = std::tuple_size_v<T>;
-          _read(is, size);
-          ASSERT(size == std::tuple_size_v<T>);
-          // Here we use foreach_in_tuple to iterate over the elements of the tuple at
-          // compile time, since std::get<i> is constexpr after C++14.
-          foreach_in_tuple(t, [&](auto &elem, auto) { deserialize(elem, is); });
-        } else if constexpr (is_map_container_v<T>) {
-          _debug("deserialize: is_map_container_v<T>");
-          size_t size;
-          _read(is, size);
-          for (size_t i = 0; i < size; ++i) {
-            typename T::key_type key;
-            typename T::mapped_type value;
-            deserialize(key, is);
-            deserialize(value, is);
-            t.insert(std::make_pair(key, value));
-          }
-        } else if constexpr (is_set_container_v<T>) {
-          _debug("deserialize: is_set_container_v<T>");
-          size_t size;
-          _read(is, size);
-          for (size_t i = 0; i < size; ++i) {
-            typename T::value_type value;
-            deserialize(value, is);
-            t.insert(value);
-          }
-        } else {
-          static_assert(always_false<T>, "T is a supported container type, but it's serializer is missing.");
-        }
-      } else if constexpr (is_supported_literal_v<T>) {
-        if constexpr (is_cstring_v<T>) {
-          // Reading a string in this case, because we are storing char* as strings.
-          string s;
-          deserialize(s, is);
-          // The user should preallocate enough spaces for C-style strings.
-          memcpy(t, s.c_str(), s.size());
-        } else {
-          _read(is, t);
-        }
-      } else if constexpr (is_base_of_v<BinSerializable, remove_cv_t<T>>) {
-        _debug("deserialize: is_base_of_v<BinSerializable, remove_cv_t<T>>");
-        string s;
-        deserialize(s, is);
-        t.deserializeFromString(s);
-      } else {
-        static_assert(always_false<T>, "T is not a supported type, you must provide a deserialize function");
-      }
+      TRACE("deserialize(T& t, std::istream& is)");
+      _throw_if_failed(try_deserialize(t, is));
     }
     template <typename T>
     void deserialize(T &t, const string &file_name) {
-      _debug("deserialize(T& t, const string &file_name)");
+      TRACE("deserialize(T& t, const string &file_name)");
+      _throw_if_failed(try_deserialize(t, file_name));
+    }
+    template <typename T>
+    void deserialize(T &t, std::istream &is, const DecodeLimits &limits) {
+      TRACE("deserialize(T& t, std::istream& is, const DecodeLimits& limits)");
+      _throw_if_failed(try_deserialize(t, is, limits));
+    }
+    template <typename T>
+    void deserialize(T &t, const string &file_name, const DecodeLimits &limits) {
+      TRACE("deserialize(T& t, const string &file_name, const DecodeLimits& limits)");
+      _throw_if_failed(try_deserialize(t, file_name, limits));
+    }
+
+    template <typename T>
+    DecodeResult try_deserialize(T &t, std::istream &is) {
+      TRACE("try_deserialize(T& t, std::istream& is)");
+      METRICS_SCOPE(T, metrics::Op::deserialize, is);
+      DecodeResult r;
+      r.code = _deserialize(t, is, r.offset);
+      return r;
+    }
+    template <typename T>
+    DecodeResult try_deserialize(T &t, const string &file_name) {
+      TRACE("try_deserialize(T& t, const string &file_name)");
       std::ifstream is(file_name, std::ios::binary);
       // Check if file exists
-      ASSERT(is.good());
-      deserialize(t, is);
-      is.close();
+      if (!is.good()) {
+        return DecodeResult{DecodeErrc::open_failed, 0};
+      }
+      return try_deserialize(t, is);
+    }
+    template <typename T>
+    DecodeResult try_deserialize(T &t, std::istream &is, const DecodeLimits &limits) {
+      TRACE("try_deserialize(T& t, std::istream& is, const DecodeLimits& limits)");
+      DecodeScope scope(limits);
+      return try_deserialize(t, is);
+    }
+    template <typename T>
+    DecodeResult try_deserialize(T &t, const string &file_name, const DecodeLimits &limits) {
+      TRACE("try_deserialize(T& t, const string &file_name, const DecodeLimits& limits)");
+      DecodeScope scope(limits);
+      return try_deserialize(t, file_name);
     }
   } // namespace binary
 } // namespace serializer
@@ -1,22 +1,33 @@
 #pragma once
 
 #include "common.h"
+#include "errors.h"
+#include "metrics.h"
 #include "thirdparty/base64.h"
 #include "thirdparty/tinyxml2.h"
 #include "type_utils.h"
 
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
 #include <charconv>
+#include <cstdio>
 #include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <initializer_list>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <list>
 #include <map>
+#include <memory>
+#include <optional>
 #include <set>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <variant>
 #include <vector>
@@ -34,6 +45,16 @@ namespace serializer {
       virtual void deserializeFromXML(const vector<string> &strings) = 0;
     };
 
+    class XMLWriter;
+    class XMLReader;
+    // Unlike XMLSerializable, whose strings are standalone documents escaped into the parent and
+    // parsed again on read, the fields are written into the element of the object itself and read
+    // from it. Nested objects are thus printed and parsed once, along with the whole document.
+    struct XMLSerializableV2 {
+      virtual void serializeToXML(XMLWriter &writer) const = 0;
+      virtual void deserializeFromXML(XMLReader &reader) = 0;
+    };
+
     // anonymous namespace for private-like helper functions
     namespace {
       using namespace tinyxml2;
@@ -45,11 +66,13 @@ namespace serializer {
       template <typename T>
       typename std::enable_if_t<is_supported_literal_v<T>, string> to_string_value(const T &t);
       template <typename T>
+      typename std::enable_if_t<std::is_arithmetic_v<T>, bool> parse_literal(const char *s, T &t);
+      template <typename T>
       typename std::enable_if_t<is_supported_literal_v<T>, T> from_string_value(const string &str);
 
       template <typename T>
       typename std::enable_if_t<is_supported_literal_v<T>, string> serialize_to_literal(const T &t) {
-        _debug("serialize_to_literal(const T& t)");
+        TRACE("serialize_to_literal(const T& t)");
         if constexpr (is_same_v<remove_cv_t<T>, string>) {
           // due to the limitation of tinyxml2 (it only accpets char*), we'd like to discard
           // contents after the first '\0' for consistency.
@@ -76,44 +99,64 @@ namespace serializer {
             ASSERT(ss.good());
             result = ss.str();
           } else if constexpr (std::is_integral_v<T>) {
-            result.resize(std::numeric_limits<T>::digits10 + 1);
+            // digits10 is one less than the longest decimal representation, plus one for the sign.
+            result.resize(std::numeric_limits<T>::digits10 + 2);
             auto [ptr, ec] = std::to_chars(result.data(), result.data() + result.size(), t);
             if (ec != std::errc()) {
-              throw std::runtime_error("failed to convert " + std::to_string(t) + " to string");
+              FAIL("failed to convert " + std::to_string(t) + " to string");
             }
             result.resize(ptr - result.data());
           } else {
             constexpr auto x = impossible_error(t, "is_arithmetic but not fp or integral");
           }
-          _debug(string("serialize_to_literal(const T& t) result: ") + result);
+          TRACE("serialize_to_literal(const T& t) result: %s", result.c_str());
           return result;
         } else {
           constexpr auto x = impossible_error(t, "Unsupported type for serialization to literal.");
         }
       }
 
+      // Parses an arithmetic literal without throwing. The whole of s must be consumed.
+      template <typename T>
+      typename std::enable_if_t<std::is_arithmetic_v<T>, bool> parse_literal(const char *s, T &t) {
+        TRACE("parse_literal(const char* s, T& t)");
+        const char *end = s + strlen(s);
+        if constexpr (std::is_floating_point_v<T>) {
+          // we first interpret the string with highest precision available, then cast it to the
+          // desired type. This can help us get rid of writing a bunch of if-else statements.
+          char *parsed_end = nullptr;
+          const long double v = std::strtold(s, &parsed_end);
+          if (parsed_end == s || parsed_end != end) {
+            return false;
+          }
+          t = static_cast<T>(v);
+          return true;
+        } else if constexpr (is_same_v<remove_cv_t<T>, bool>) {
+          // std::from_chars does not accept bool. Bools are treated as unsigned ints.
+          unsigned v;
+          auto [ptr, ec] = std::from_chars(s, end, v);
+          if (ec != std::errc() || ptr != end) {
+            return false;
+          }
+          t = v != 0;
+          return true;
+        } else if constexpr (std::is_integral_v<T>) {
+          auto [ptr, ec] = std::from_chars(s, end, t);
+          return ec == std::errc() && ptr == end;
+        } else {
+          static_assert(always_false<T>, "T is neither fp nor integral.");
+        }
+      }
+
       template <typename T>
       typename std::enable_if_t<is_supported_literal_v<T>, T> deserialize_from_literal(const string &s) {
-        _debug("deserialize_from_literal(const string& s)");
+        TRACE("deserialize_from_literal(const string& s)");
         if constexpr (std::is_arithmetic_v<T>) {
-          if constexpr (std::is_floating_point_v<T>) {
-            // we first interpret the string with highest precision available, then cast it to the
-            // desired type. This can help us get rid of writing a bunch of if-else statements.
-            return static_cast<T>(std::stold(s));
-          } else if constexpr (std::is_integral_v<T>) {
-            // note that bools are also integral, treated as unsigned ints.
-            if constexpr (std::is_signed_v<T>) {
-              // ditto.
-              return static_cast<T>(std::stoll(s));
-            } else if constexpr (std::is_unsigned_v<T>) {
-              // ditto.
-              return static_cast<T>(std::stoull(s));
-            } else {
-              static_assert(always_false<T>, "T is neither signed nor unsigned.");
-            }
-          } else {
-            static_assert(always_false<T>, "T is neither fp nor integral.");
+          T t;
+          if (!parse_literal(s.c_str(), t)) {
+            FAIL("failed to convert " + s + " to a number");
           }
+          return t;
         } else if constexpr (is_same_v<remove_cv_t<T>, string>) {
           return s;
         } else if constexpr (is_same_v<remove_cv_t<T>, char *>) {
@@ -132,14 +175,29 @@ namespace serializer {
         return deserialize_from_literal<T>(str);
       }
     } // namespace
+
+    // How containers are laid out. The layout is recorded in the `layout` attribute of the
+    // serialization element, so readers pick it up by themselves.
+    //  - standard: every element is a child element named after its index;
+    //  - dense: arrays of numbers are one whitespace-separated text node, and the elements of other
+    //    containers are unnamed children (`_`, or `k` and `v` for maps), read in order;
+    //  - hybrid: the dense layout, except that arrays of numbers, and strings of at least
+    //    xml_base64_string_size bytes, are the base64 text of their raw bytes. Elements encoded this
+    //    way have an `encoding="base64"` attribute, and arrays record their element type (e.g.
+    //    "f64") and byte order, so numbers round-trip bit-exactly.
+    enum class XMLLayout { standard, dense, hybrid };
+    constexpr size_t xml_base64_string_size = 64;
+
     // declarations
     // support user-defined serialize function for custom types
     template <typename T>
-    void serialize_xml(const T &t, const string &node_name, XMLPrinter *printer);
+    void serialize_xml(const T &t, const string &node_name, XMLPrinter *printer,
+                       XMLLayout layout = XMLLayout::standard);
     template <typename T>
-    void serialize_xml(const T &t, const string &node_name, const string &file_name);
+    void serialize_xml(const T &t, const string &node_name, const string &file_name,
+                       XMLLayout layout = XMLLayout::standard);
     template <typename T>
-    string serialize_to_string_xml(const T &t, const string &node_name);
+    string serialize_to_string_xml(const T &t, const string &node_name, XMLLayout layout = XMLLayout::standard);
     template <typename T>
     void serialize_to_b64file_xml(const T &t, const string &node_name, const string &file_name);
 
@@ -152,46 +210,701 @@ namespace serializer {
     template <typename T>
     void deserialize_from_b64file_xml(T &t, const string &node_name, const string &file_name);
 
+    // Exception-free variants of deserialize_xml. On failure, they return the error and the path of
+    // the element where decoding stopped, and t is left partially decoded.
+    template <typename T>
+    XMLDecodeResult try_deserialize_xml(T &t, const string &node_name, const XMLElement *parent);
+    template <typename T>
+    XMLDecodeResult try_deserialize_xml(T &t, const string &node_name, const string &file_name);
+    template <typename T>
+    XMLDecodeResult try_deserialize_from_string_xml(T &t, const string &node_name, const string &xml_string);
+
+    // Where the decoding failed: the element, and the name of its missing child or attribute, if any.
+    // Not part of the API; it is only out of the anonymous namespace because XMLReader holds one.
+    struct XMLErrorSite {
+      const XMLElement *elem = nullptr;
+      char missing[64] = {};
+
+      DecodeErrc fail(DecodeErrc e, const XMLElement *at, const char *missing_name = nullptr) {
+        elem = at;
+        if (missing_name != nullptr) {
+          strncpy(missing, missing_name, sizeof(missing) - 1);
+        }
+        return e;
+      }
+    };
+
+    namespace {
+      inline void _append(char *buf, size_t cap, size_t &len, const char *s) {
+        while (*s != '\0' && len + 1 < cap) {
+          buf[len++] = *s++;
+        }
+        buf[len] = '\0';
+      }
+
+      inline void _fill_path(XMLDecodeResult &r, const XMLErrorSite &site) {
+        const char *names[64];
+        size_t depth = 0;
+        for (const XMLNode *node = site.elem; node != nullptr && node->ToElement() != nullptr && depth < 64;
+             node = node->Parent()) {
+          names[depth++] = node->ToElement()->Name();
+        }
+        size_t len = 0;
+        while (depth > 0) {
+          _append(r.path, sizeof(r.path), len, names[--depth]);
+          if (depth > 0 || site.missing[0] != '\0') {
+            _append(r.path, sizeof(r.path), len, "/");
+          }
+        }
+        _append(r.path, sizeof(r.path), len, site.missing);
+      }
+
+      // Reads the size attribute of a container element.
+      inline DecodeErrc _read_size(const XMLElement *elem, size_t &size, XMLErrorSite &site) {
+        const char *attr = elem->Attribute("size");
+        if (attr == nullptr) {
+          return site.fail(DecodeErrc::missing_node, elem, "@size");
+        }
+        if (!parse_literal(attr, size)) {
+          return site.fail(DecodeErrc::bad_literal, elem, "@size");
+        }
+        return DecodeErrc::ok;
+      }
+
+      // Arrays of these are packed into a text node in the dense layout. bool is left out, since
+      // it is not supported as a literal.
+      template <typename T>
+      constexpr bool is_packed_text_v = std::is_arithmetic_v<T> && !is_same_v<remove_cv_t<T>, bool>;
+
+      inline const char *_layout_name(XMLLayout layout) {
+        switch (layout) {
+        case XMLLayout::dense:
+          return "dense";
+        case XMLLayout::hybrid:
+          return "hybrid";
+        default:
+          return "standard";
+        }
+      }
+      // The layout of the document elem belongs to.
+      inline XMLLayout _document_layout(const XMLElement *elem) {
+        const XMLElement *root = elem->GetDocument()->FirstChildElement("serialization");
+        const char *layout = root != nullptr ? root->Attribute("layout") : nullptr;
+        for (XMLLayout l : {XMLLayout::dense, XMLLayout::hybrid}) {
+          if (layout != nullptr && strcmp(layout, _layout_name(l)) == 0) {
+            return l;
+          }
+        }
+        return XMLLayout::standard;
+      }
+
+      // Raw bytes in base64, for the hybrid layout.
+      inline const char *_byte_order() {
+        const uint16_t one = 1;
+        unsigned char first;
+        memcpy(&first, &one, 1);
+        return first == 1 ? "little" : "big";
+      }
+      // Whether the raw bytes of E can be stored in base64, tagged by kind and width alone. Floating
+      // point types must be IEEE binary32, binary64 or binary128, so that e.g. an x87 long double
+      // (80 bits padded to 128) is never read as a binary128 one. Arrays of other types are stored as
+      // packed text instead.
+      template <typename E>
+      constexpr bool is_raw_portable_v =
+          !std::is_floating_point_v<E> ||
+          (std::numeric_limits<E>::is_iec559 &&
+           (std::numeric_limits<E>::digits == 24 || std::numeric_limits<E>::digits == 53 ||
+            std::numeric_limits<E>::digits == 113));
+      // Whether E is signed depends on the platform.
+      template <typename E>
+      constexpr bool has_platform_signedness_v = is_same_v<remove_cv_t<E>, char> || is_same_v<remove_cv_t<E>, wchar_t>;
+      // e.g. "i32", "u8" or "f64". Types whose signedness depends on the platform are always tagged
+      // as signed, and accept either tag when read, since their bytes are the same.
+      template <typename E>
+      void _raw_type_name(char (&buf)[8]) {
+        static_assert(is_raw_portable_v<E>, "E has no portable raw representation");
+        const char kind = std::is_floating_point_v<E>                          ? 'f'
+                          : std::is_signed_v<E> || has_platform_signedness_v<E> ? 'i'
+                                                                               : 'u';
+        snprintf(buf, sizeof(buf), "%c%zu", kind, sizeof(E) * 8);
+      }
+      // Checks s up front, since base64_decode throws on malformed input.
+      inline bool _is_base64(const char *s) {
+        size_t len = 0;
+        size_t padding = 0;
+        for (; s[len] != '\0'; len++) {
+          const char c = s[len];
+          if (c == '=') {
+            padding++;
+          } else if (padding > 0 || (!isalnum(static_cast<unsigned char>(c)) && c != '+' && c != '/')) {
+            return false;
+          }
+        }
+        return len % 4 == 0 && padding <= 2;
+      }
+      inline bool _is_base64_element(const XMLElement *elem) {
+        const char *encoding = elem->Attribute("encoding");
+        return encoding != nullptr && strcmp(encoding, "base64") == 0;
+      }
+      template <typename T>
+      void _push_base64_array(const T &t, XMLPrinter *printer) {
+        using E = typename T::value_type;
+        char type[8];
+        _raw_type_name<E>(type);
+        printer->PushAttribute("encoding", "base64");
+        printer->PushAttribute("type", type);
+        printer->PushAttribute("order", _byte_order());
+        auto push = [printer](const E *data, size_t size) {
+          printer->PushText(base64_encode(reinterpret_cast<const unsigned char *>(data), size * sizeof(E)).c_str());
+        };
+        if constexpr (is_same_v<T, std::vector<E, typename T::allocator_type>>) {
+          push(t.data(), t.size());
+        } else {
+          const std::vector<E> contiguous(t.begin(), t.end());
+          push(contiguous.data(), contiguous.size());
+        }
+      }
+      // Reads the base64 text of an array whose size is already set.
+      template <typename T>
+      DecodeErrc _read_base64_array(const XMLElement *elem, T &t, XMLErrorSite &site) {
+        using E = typename T::value_type;
+        const char *elem_type = elem->Attribute("type");
+        const char *order = elem->Attribute("order");
+        char type[8];
+        _raw_type_name<E>(type);
+        bool type_matches = elem_type != nullptr && strcmp(elem_type, type) == 0;
+        if constexpr (has_platform_signedness_v<E>) {
+          type_matches = type_matches ||
+                         (elem_type != nullptr && elem_type[0] == 'u' && strcmp(elem_type + 1, type + 1) == 0);
+        }
+        if (!type_matches) {
+          return site.fail(DecodeErrc::size_mismatch, elem, "@type");
+        }
+        if (order == nullptr || (strcmp(order, "little") != 0 && strcmp(order, "big") != 0)) {
+          return site.fail(DecodeErrc::bad_literal, elem, "@order");
+        }
+        const char *text = elem->GetText();
+        if (text == nullptr) {
+          text = "";
+        }
+        if (!_is_base64(text)) {
+          return site.fail(DecodeErrc::bad_literal, elem);
+        }
+        const string bytes = base64_decode(std::string_view(text));
+        if (bytes.size() != t.size() * sizeof(E)) {
+          return site.fail(DecodeErrc::size_mismatch, elem);
+        }
+        const bool swap = strcmp(order, _byte_order()) != 0;
+        const char *p = bytes.data();
+        for (auto &el : t) {
+          char raw[sizeof(E)];
+          memcpy(raw, p, sizeof(E));
+          if (swap) {
+            std::reverse(raw, raw + sizeof(E));
+          }
+          memcpy(&el, raw, sizeof(E));
+          p += sizeof(E);
+        }
+        return DecodeErrc::ok;
+      }
+
+      // Appends the numbers of t to text, separated by spaces.
+      template <typename T>
+      void _append_packed_text(const T &t, string &text) {
+        using E = typename T::value_type;
+        char buf[64];
+        for (const E &el : t) {
+          if (!text.empty()) {
+            text.push_back(' ');
+          }
+          if constexpr (std::is_floating_point_v<E>) {
+            // the same precision as serialize_to_literal
+            const int n = snprintf(buf, sizeof(buf), "%.*Lg", std::numeric_limits<E>::max_digits10,
+                                   static_cast<long double>(el));
+            text.append(buf, n);
+          } else {
+            auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), el);
+            text.append(buf, ptr);
+          }
+        }
+      }
+      // Parses the numbers of a packed text node into t, in one pass.
+      template <typename T>
+      bool _parse_packed_text(const char *text, T &t) {
+        using E = typename T::value_type;
+        const char *p = text;
+        const char *end = text + strlen(text);
+        for (auto &el : t) {
+          while (p != end && isspace(static_cast<unsigned char>(*p))) {
+            p++;
+          }
+          if constexpr (std::is_floating_point_v<E>) {
+            char *parsed_end = nullptr;
+            const long double v = std::strtold(p, &parsed_end);
+            if (parsed_end == p) {
+              return false;
+            }
+            el = static_cast<E>(v);
+            p = parsed_end;
+          } else {
+            auto [ptr, ec] = std::from_chars(p, end, el);
+            if (ec != std::errc()) {
+              return false;
+            }
+            p = ptr;
+          }
+          if (p != end && !isspace(static_cast<unsigned char>(*p))) {
+            return false;
+          }
+        }
+        while (p != end && isspace(static_cast<unsigned char>(*p))) {
+          p++;
+        }
+        return p == end;
+      }
+
+      template <typename T>
+      DecodeErrc _deserialize_xml_element(T &t, const XMLElement *elem, XMLErrorSite &site, XMLLayout layout);
+
+      // The decoder behind both deserialize_xml and try_deserialize_xml. Child names are formatted
+      // into stack buffers, so that nothing but the decoded values is allocated.
+      template <typename T>
+      DecodeErrc _deserialize_xml(T &t, const char *node_name, const XMLElement *parent, XMLErrorSite &site,
+                                  XMLLayout layout) {
+        TRACE("_deserialize_xml(T& t, const char* node_name, const XMLElement* parent, XMLErrorSite& site)");
+        const XMLElement *elem = parent->FirstChildElement(node_name);
+        if (elem == nullptr) {
+          return site.fail(DecodeErrc::missing_node, parent, node_name);
+        }
+        return _deserialize_xml_element(t, elem, site, layout);
+      }
+
+      // In the dense layout, the next child of a container, which must exist.
+      inline DecodeErrc _next_child(const XMLElement *elem, const XMLElement *&child, const char *name,
+                                    XMLErrorSite &site) {
+        child = child == nullptr ? elem->FirstChildElement() : child->NextSiblingElement();
+        if (child == nullptr) {
+          return site.fail(DecodeErrc::missing_node, elem, name);
+        }
+        return DecodeErrc::ok;
+      }
+    } // namespace
+
+    // Writes the fields of an XMLSerializableV2 object as children of its element.
+    class XMLWriter {
+    public:
+      XMLWriter(XMLPrinter *printer, XMLLayout layout) : printer_(printer), layout_(layout) {}
+
+      template <typename T>
+      XMLWriter &write(const T &t, const char *node_name) {
+        serialize_xml(t, node_name, printer_, layout_);
+        return *this;
+      }
+
+      // The printer of the document, open on the element of the object. Attributes must be pushed
+      // before the first field is written.
+      XMLPrinter *printer() const { return printer_; }
+      XMLLayout layout() const { return layout_; }
+
+    private:
+      XMLPrinter *printer_;
+      XMLLayout layout_;
+    };
+
+    // Reads the fields of an XMLSerializableV2 object from the children of its element. The first
+    // failure sticks: later reads are skipped, and the error is reported with its path by the
+    // deserialize function that was called.
+    class XMLReader {
+    public:
+      XMLReader(const XMLElement *elem, XMLErrorSite &site, XMLLayout layout)
+          : elem_(elem), site_(site), layout_(layout) {}
+
+      template <typename T>
+      XMLReader &read(T &t, const char *node_name) {
+        if (status_ == DecodeErrc::ok) {
+          status_ = _deserialize_xml(t, node_name, elem_, site_, layout_);
+        }
+        return *this;
+      }
+
+      // Fails the read at the element of the object, e.g. when a field is out of range.
+      void fail(DecodeErrc e) {
+        if (status_ == DecodeErrc::ok) {
+          status_ = site_.fail(e, elem_);
+        }
+      }
+
+      // The element of the object, for attributes or optional fields.
+      const XMLElement *element() const { return elem_; }
+      XMLLayout layout() const { return layout_; }
+      DecodeErrc status() const { return status_; }
+      explicit operator bool() const { return status_ == DecodeErrc::ok; }
+
+    private:
+      const XMLElement *elem_;
+      XMLErrorSite &site_;
+      XMLLayout layout_;
+      DecodeErrc status_ = DecodeErrc::ok;
+    };
+
+    namespace {
+      template <typename T>
+      DecodeErrc _deserialize_xml_element(T &t, const XMLElement *elem, XMLErrorSite &site, XMLLayout layout) {
+        TRACE("_deserialize_xml_element(T& t, const XMLElement* elem, XMLErrorSite& site, XMLLayout layout)");
+        const bool dense = layout != XMLLayout::standard;
+        if constexpr (is_supported_container_v<T>) {
+          TRACE("is_supported_container_v<T>");
+          char name[32];
+          if constexpr (is_pair_v<T>) {
+            TRACE("_deserialize_xml: is_pair_v<T>");
+            RETURN_IF_ERROR(_deserialize_xml(std::get<0>(t), "first", elem, site, layout));
+            RETURN_IF_ERROR(_deserialize_xml(std::get<1>(t), "second", elem, site, layout));
+          } else if constexpr (is_array_container_v<T>) {
+            TRACE("_deserialize_xml: is_array_container_v<T>");
+            // child count
+            size_t size;
+            RETURN_IF_ERROR(_read_size(elem, size, site));
+            // resize
+            t.resize(size);
+            if constexpr (is_packed_text_v<typename T::value_type>) {
+              if (_is_base64_element(elem)) {
+                if constexpr (!is_raw_portable_v<typename T::value_type>) {
+                  // written by a platform with another representation of the type
+                  return site.fail(DecodeErrc::size_mismatch, elem, "@type");
+                } else {
+                  return _read_base64_array(elem, t, site);
+                }
+              }
+              if (dense) {
+                const char *text = elem->GetText();
+                if (!_parse_packed_text(text != nullptr ? text : "", t)) {
+                  return site.fail(DecodeErrc::bad_literal, elem);
+                }
+                return DecodeErrc::ok;
+              }
+            }
+            size_t index = 0;
+            const XMLElement *child = nullptr;
+            for (auto &el : t) {
+              if (dense) {
+                RETURN_IF_ERROR(_next_child(elem, child, "_", site));
+                RETURN_IF_ERROR(_deserialize_xml_element(el, child, site, layout));
+              } else {
+                snprintf(name, sizeof(name), "_%zu", index++);
+                RETURN_IF_ERROR(_deserialize_xml(el, name, elem, site, layout));
+              }
+            }
+          } else if constexpr (is_tuple_v<T>) {
+            TRACE("_deserialize_xml: is_tuple_v<T>");
+            // Here we use foreach_in_tuple to iterate over the elements of the tuple at
+            // compile time, since std::get<i> is constexpr after C++14.
+            DecodeErrc e = DecodeErrc::ok;
+            foreach_in_tuple(t, [&](auto &el, const size_t i) {
+              if (e == DecodeErrc::ok) {
+                snprintf(name, sizeof(name), "_%zu", i);
+                e = _deserialize_xml(el, name, elem, site, layout);
+              }
+            });
+            return e;
+          } else if constexpr (is_map_container_v<T>) {
+            TRACE("_deserialize_xml: is_map_container_v<T>");
+            size_t size;
+            RETURN_IF_ERROR(_read_size(elem, size, site));
+            const XMLElement *child = nullptr;
+            for (size_t i = 0; i < size; i++) {
+              typename T::key_type key;
+              typename T::mapped_type value;
+              if (dense) {
+                RETURN_IF_ERROR(_next_child(elem, child, "k", site));
+                RETURN_IF_ERROR(_deserialize_xml_element(key, child, site, layout));
+                RETURN_IF_ERROR(_next_child(elem, child, "v", site));
+                RETURN_IF_ERROR(_deserialize_xml_element(value, child, site, layout));
+              } else {
+                snprintf(name, sizeof(name), "_%zu_k", i);
+                RETURN_IF_ERROR(_deserialize_xml(key, name, elem, site, layout));
+                snprintf(name, sizeof(name), "_%zu_v", i);
+                RETURN_IF_ERROR(_deserialize_xml(value, name, elem, site, layout));
+              }
+              t.insert(std::make_pair(key, value));
+            }
+          } else if constexpr (is_set_container_v<T>) {
+            TRACE("_deserialize_xml: is_set_container_v<T>");
+            size_t size;
+            RETURN_IF_ERROR(_read_size(elem, size, site));
+            const XMLElement *child = nullptr;
+            for (size_t i = 0; i < size; i++) {
+              typename T::value_type value;
+              if (dense) {
+                RETURN_IF_ERROR(_next_child(elem, child, "_", site));
+                RETURN_IF_ERROR(_deserialize_xml_element(value, child, site, layout));
+              } else {
+                snprintf(name, sizeof(name), "_%zu", i);
+                RETURN_IF_ERROR(_deserialize_xml(value, name, elem, site, layout));
+              }
+              t.insert(value);
+            }
+          } else {
+            static_assert(always_false<T>, "T is a supported container type, but it's serializer is missing.");
+          }
+          return DecodeErrc::ok;
+        } else if constexpr (is_supported_literal_v<T>) {
+          if constexpr (is_same_v<remove_cv_t<T>, string>) {
+            if (_is_base64_element(elem)) {
+              const char *text = elem->GetText();
+              if (text == nullptr) {
+                text = "";
+              }
+              if (!_is_base64(text)) {
+                return site.fail(DecodeErrc::bad_literal, elem);
+              }
+              t = base64_decode(std::string_view(text));
+              return DecodeErrc::ok;
+            }
+          }
+          const char *val = elem->Attribute("val");
+          if (val == nullptr) {
+            return site.fail(DecodeErrc::missing_node, elem, "@val");
+          }
+          if constexpr (is_cstring_v<T>) {
+            // The user should preallocate enough spaces for C-style strings.
+            memcpy(t, val, strlen(val));
+          } else if constexpr (is_same_v<remove_cv_t<T>, string>) {
+            t = val;
+          } else if (!parse_literal(val, t)) {
+            return site.fail(DecodeErrc::bad_literal, elem, "@val");
+          }
+          return DecodeErrc::ok;
+        } else if constexpr (std::is_base_of_v<XMLSerializableV2, remove_cv_t<T>>) {
+          TRACE("_deserialize_xml: is_base_of_v<XMLSerializableV2, remove_cv_t<T>>");
+          XMLReader reader(elem, site, layout);
+          t.deserializeFromXML(reader);
+          return reader.status();
+        } else if constexpr (std::is_base_of_v<XMLSerializable, remove_cv_t<T>>) {
+          TRACE("_deserialize_xml: is_base_of_v<XMLSerializable, remove_cv_t<T>>");
+          vector<string> args;
+          RETURN_IF_ERROR(_deserialize_xml(args, "udt", elem, site, layout));
+          t.deserializeFromXML(args);
+          return DecodeErrc::ok;
+        } else {
+          static_assert(always_false<T>, "T is not a supported type, you must derive T from XMLSerializable");
+        }
+      }
+
+      template <typename T>
+      XMLDecodeResult _try_deserialize_document(T &t, const string &node_name, const XMLDocument &doc) {
+        XMLDecodeResult r;
+        if (doc.ErrorID() != 0) {
+          r.code = DecodeErrc::open_failed;
+          return r;
+        }
+        const XMLElement *root = doc.FirstChildElement("serialization");
+        if (root == nullptr) {
+          r.code = DecodeErrc::missing_node;
+          size_t len = 0;
+          _append(r.path, sizeof(r.path), len, "serialization");
+          return r;
+        }
+        return try_deserialize_xml(t, node_name, root);
+      }
+
+      inline void _throw_if_failed(const XMLDecodeResult &r) {
+        if (!r) {
+          FAIL(string("deserialize_xml: ") + decode_errc_message(r.code) + " at " + r.path);
+        }
+      }
+    } // namespace
+
+    // The document and printer behind the string functions, kept between calls so that the memory
+    // pools of the document and the buffer of the printer are only allocated once. A context serves
+    // one call at a time, and must not be used by the nested calls of its own user-defined types.
+    // serialize_to_string_xml and deserialize_from_string_xml use contexts of their own thread, so
+    // an explicit one is only needed to control when the memory is released.
+    class XMLContext {
+    public:
+      XMLContext() = default;
+      XMLContext(const XMLContext &) = delete;
+      XMLContext &operator=(const XMLContext &) = delete;
+
+      template <typename T>
+      string serialize_to_string(const T &t, const string &node_name, XMLLayout layout = XMLLayout::standard) {
+        return string(serialize_to_string_view(t, node_name, layout));
+      }
+      // Like serialize_to_string, but the result lives in the context until its next call.
+      template <typename T>
+      std::string_view serialize_to_string_view(const T &t, const string &node_name,
+                                                XMLLayout layout = XMLLayout::standard) {
+        TRACE("XMLContext::serialize_to_string_view(const T& t, const string &node_name, XMLLayout layout)");
+        METRICS_SCOPE(T, metrics::Op::serialize_xml);
+        Use use(*this);
+        // A call that failed halfway leaves elements open in the printer, so it starts over.
+        if (!printer_ || printer_dirty_) {
+          printer_.emplace(nullptr, true);
+        } else {
+          printer_->ClearBuffer();
+        }
+        printer_dirty_ = true;
+        printer_->OpenElement("serialization", true);
+        if (layout != XMLLayout::standard) {
+          printer_->PushAttribute("layout", _layout_name(layout));
+        }
+        serialize_xml(t, node_name.c_str(), &*printer_, layout);
+        printer_->CloseElement(true);
+        printer_dirty_ = false;
+        METRICS_BYTES_OUT(printer_->CStrSize() - 1);
+        return std::string_view(printer_->CStr(), printer_->CStrSize() - 1);
+      }
+
+      template <typename T>
+      XMLDecodeResult try_deserialize_from_string(T &t, const string &node_name, const string &xml_string) {
+        TRACE("XMLContext::try_deserialize_from_string(T& t, const string &node_name, const string &xml_string)");
+        METRICS_SCOPE(T, metrics::Op::deserialize_xml);
+        METRICS_BYTES_IN(xml_string.size());
+        Use use(*this);
+        // Parse returns the nodes of the previous document to the pools before reading this one.
+        doc_.Parse(xml_string.c_str(), xml_string.size());
+        return _try_deserialize_document(t, node_name, doc_);
+      }
+      template <typename T>
+      void deserialize_from_string(T &t, const string &node_name, const string &xml_string) {
+        _throw_if_failed(try_deserialize_from_string(t, node_name, xml_string));
+      }
+      // Parses xml in place instead of copying it, see try_deserialize_xml_in_place.
+      template <typename T>
+      XMLDecodeResult try_deserialize_in_place(T &t, const string &node_name, char *xml, size_t size) {
+        TRACE("XMLContext::try_deserialize_in_place(T& t, const string &node_name, char *xml, size_t size)");
+        METRICS_SCOPE(T, metrics::Op::deserialize_xml);
+        METRICS_BYTES_IN(size);
+        Use use(*this);
+        doc_.ParseInPlace(xml, size);
+        XMLDecodeResult r = _try_deserialize_document(t, node_name, doc_);
+        // The nodes point into xml, which may be gone before the next call.
+        doc_.Clear();
+        return r;
+      }
+
+    private:
+      class Use {
+      public:
+        explicit Use(XMLContext &ctx) : ctx_(ctx) {
+          ASSERT(!ctx_.in_use_);
+          ctx_.in_use_ = true;
+        }
+        ~Use() { ctx_.in_use_ = false; }
+
+      private:
+        XMLContext &ctx_;
+      };
+
+      XMLDocument doc_;
+      std::optional<XMLPrinter> printer_;
+      bool printer_dirty_ = false;
+      bool in_use_ = false;
+    };
+
+    namespace {
+      // The contexts of this thread, one per nesting level of the string functions, since the
+      // nested calls of XMLSerializable run while the enclosing call holds its context.
+      struct ThreadXMLContexts {
+        vector<std::unique_ptr<XMLContext>> contexts;
+        size_t depth = 0;
+      };
+      inline ThreadXMLContexts &_thread_xml_contexts() {
+        thread_local ThreadXMLContexts contexts;
+        return contexts;
+      }
+
+      // Borrows the context of the current nesting level for the lifetime of this object.
+      class ThreadXMLContextScope {
+      public:
+        ThreadXMLContextScope() : contexts_(_thread_xml_contexts()) {
+          if (contexts_.depth == contexts_.contexts.size()) {
+            contexts_.contexts.push_back(std::make_unique<XMLContext>());
+          }
+          ctx_ = contexts_.contexts[contexts_.depth++].get();
+        }
+        ~ThreadXMLContextScope() { contexts_.depth--; }
+        ThreadXMLContextScope(const ThreadXMLContextScope &) = delete;
+        ThreadXMLContextScope &operator=(const ThreadXMLContextScope &) = delete;
+
+        XMLContext *operator->() const { return ctx_; }
+
+      private:
+        ThreadXMLContexts &contexts_;
+        XMLContext *ctx_;
+      };
+    } // namespace
+
+    // Frees the contexts of this thread that are not in use, e.g. after decoding an unusually large
+    // document, whose pools would otherwise stay allocated until the thread exits.
+    inline void release_thread_xml_contexts() {
+      ThreadXMLContexts &contexts = _thread_xml_contexts();
+      contexts.contexts.resize(contexts.depth);
+    }
+
     // definitions
     template <typename T>
-    void serialize_xml(const T &t, const string &node_name, XMLPrinter *printer) {
-      _debug("serialize_xml(const T& t, const string &node_name, XMLPrinter *printer)");
+    void serialize_xml(const T &t, const string &node_name, XMLPrinter *printer, XMLLayout layout) {
+      TRACE("serialize_xml(const T& t, const string &node_name, XMLPrinter *printer, XMLLayout layout)");
+      METRICS_SCOPE(T, metrics::Op::serialize_xml);
       printer->OpenElement(node_name.c_str(), true);
       if constexpr (is_supported_container_v<T>) {
-        _debug("is_supported_container_v<T>");
+        TRACE("is_supported_container_v<T>");
         if constexpr (is_pair_v<T>) {
-          _debug("serialize_xml: is_pair_v<T>");
-          serialize_xml(std::get<0>(t), "first", printer);
-          serialize_xml(std::get<1>(t), "second", printer);
+          TRACE("serialize_xml: is_pair_v<T>");
+          serialize_xml(std::get<0>(t), "first", printer, layout);
+          serialize_xml(std::get<1>(t), "second", printer, layout);
         } else if constexpr (is_array_container_v<T>) {
-          _debug("serialize_xml: is_array_container_v<T>");
+          TRACE("serialize_xml: is_array_container_v<T>");
           printer->PushAttribute("size", std::to_string(t.size()).c_str());
+          if constexpr (is_packed_text_v<typename T::value_type>) {
+            if constexpr (is_raw_portable_v<typename T::value_type>) {
+              if (layout == XMLLayout::hybrid) {
+                _push_base64_array(t, printer);
+                printer->CloseElement(true);
+                return;
+              }
+            }
+            if (layout != XMLLayout::standard) {
+              string text;
+              _append_packed_text(t, text);
+              printer->PushText(text.c_str());
+              printer->CloseElement(true);
+              return;
+            }
+          }
           size_t index = 0;
           for (const auto &el : t) {
-            serialize_xml(el, string("_") + std::to_string(index++), printer);
+            serialize_xml(el, layout != XMLLayout::standard ? "_" : string("_") + std::to_string(index++), printer,
+                          layout);
           }
         } else if constexpr (is_tuple_v<T>) {
-          _debug("serialize_xml: is_tuple_v<T>");
+          TRACE("serialize_xml: is_tuple_v<T>");
           // Here we use foreach_in_tuple to iterate over the elements of the tuple at
           // compile time, since std::get<i> is constexpr after C++14.
           foreach_in_tuple(t, [&](const auto &el, const size_t i) {
-            serialize_xml(el, string("_") + std::to_string(i), printer);
+            serialize_xml(el, string("_") + std::to_string(i), printer, layout);
           });
         } else if constexpr (is_map_container_v<T>) {
-          _debug("serialize_xml: is_map_container_v<T>");
+          TRACE("serialize_xml: is_map_container_v<T>");
           printer->PushAttribute("size", std::to_string(t.size()).c_str());
           size_t index = 0;
           for (const auto &el : t) {
-            serialize_xml(el.first, string("_") + std::to_string(index) + "_k", printer);
-            serialize_xml(el.second, string("_") + std::to_string(index) + "_v", printer);
+            if (layout != XMLLayout::standard) {
+              serialize_xml(el.first, "k", printer, layout);
+              serialize_xml(el.second, "v", printer, layout);
+            } else {
+              serialize_xml(el.first, string("_") + std::to_string(index) + "_k", printer, layout);
+              serialize_xml(el.second, string("_") + std::to_string(index) + "_v", printer, layout);
+            }
             index++;
           }
         } else if constexpr (is_set_container_v<T>) {
-          _debug("serialize_xml: is_set_container_v<T>");
+          TRACE("serialize_xml: is_set_container_v<T>");
           printer->PushAttribute("size", std::to_string(t.size()).c_str());
           size_t index = 0;
           for (const auto &el : t) {
-            serialize_xml(el, string("_") + std::to_string(index++), printer);
+            serialize_xml(el, layout != XMLLayout::standard ? "_" : string("_") + std::to_string(index++), printer,
+                          layout);
           }
         } else {
           constexpr auto x =
@@ -200,13 +913,25 @@ namespace serializer {
       } else if constexpr (is_supported_literal_v<T>) {
         if constexpr (is_cstring_v<T>) {
           printer->PushAttribute("val", t);
+        } else if constexpr (is_same_v<remove_cv_t<T>, string>) {
+          if (layout == XMLLayout::hybrid && t.size() >= xml_base64_string_size) {
+            // Unlike val, this keeps characters after a '\0'.
+            printer->PushAttribute("encoding", "base64");
+            printer->PushText(base64_encode(t).c_str());
+          } else {
+            printer->PushAttribute("val", to_string_value(t).c_str());
+          }
         } else {
           printer->PushAttribute("val", to_string_value(t).c_str());
         }
+      } else if constexpr (is_base_of_v<XMLSerializableV2, remove_cv_t<T>>) {
+        TRACE("serialize_xml: is_base_of_v<XMLSerializableV2, remove_cv_t<T>>");
+        XMLWriter writer(printer, layout);
+        t.serializeToXML(writer);
       } else if constexpr (is_base_of_v<XMLSerializable, remove_cv_t<T>>) {
-        _debug("serialize_xml: is_base_of_v<XMLSerializable, remove_cv_t<T>>");
+        TRACE("serialize_xml: is_base_of_v<XMLSerializable, remove_cv_t<T>>");
         vector<string> v = t.serializeToXML();
-        serialize_xml(v, "udt", printer);
+        serialize_xml(v, "udt", printer, layout);
       } else {
         constexpr auto x =
             impossible_error(t, "T is not a supported type, you must derive T from XMLSerializable");
@@ -214,30 +939,33 @@ namespace serializer {
       printer->CloseElement(true);
     }
     template <typename T>
-    void serialize_xml(const T &t, const string &node_name, const string &file_name) {
-      _debug("serialize_xml(const T& t, const string &node_name, const string &file_name)");
-      XMLPrinter printer;
+    void serialize_xml(const T &t, const string &node_name, const string &file_name, XMLLayout layout) {
+      TRACE("serialize_xml(const T& t, const string &node_name, const string &file_name, XMLLayout layout)");
+      METRICS_SCOPE(T, metrics::Op::serialize_xml);
+      // The printer writes straight to the file as it goes, instead of buffering the whole
+      // document, so memory does not grow with the document.
+      std::unique_ptr<FILE, int (*)(FILE *)> fp(fopen(file_name.c_str(), "w"), &fclose);
+      ASSERT(fp != nullptr);
+      XMLPrinter printer(fp.get(), true);
       printer.OpenElement("serialization", true);
-      serialize_xml(t, node_name, &printer);
+      if (layout != XMLLayout::standard) {
+        printer.PushAttribute("layout", _layout_name(layout));
+      }
+      serialize_xml(t, node_name, &printer, layout);
       printer.CloseElement(true);
-      std::ofstream ofs(file_name);
-      ASSERT(ofs.is_open());
-      ofs << printer.CStr();
-      ASSERT(ofs.good());
-      ofs.close();
+      METRICS_BYTES_OUT(ftell(fp.get()));
+      ASSERT(ferror(fp.get()) == 0);
+      ASSERT(fclose(fp.release()) == 0);
     }
     template <typename T>
-    string serialize_to_string_xml(const T &t, const string &node_name) {
-      _debug("serialize_to_string_xml(const T& t, const string &node_name)");
-      XMLPrinter printer;
-      printer.OpenElement("serialization", true);
-      serialize_xml(t, node_name.c_str(), &printer);
-      printer.CloseElement(true);
-      return string(printer.CStr());
+    string serialize_to_string_xml(const T &t, const string &node_name, XMLLayout layout) {
+      TRACE("serialize_to_string_xml(const T& t, const string &node_name, XMLLayout layout)");
+      ThreadXMLContextScope ctx;
+      return ctx->serialize_to_string(t, node_name, layout);
     }
     template <typename T>
     void serialize_to_b64file_xml(const T &t, const string &node_name, const string &file_name) {
-      _debug("serialize_to_b64file_xml(const T& t, const string &node_name, const string &file_name)");
+      TRACE("serialize_to_b64file_xml(const T& t, const string &node_name, const string &file_name)");
       string xml = serialize_to_string_xml(t, node_name);
       string b64_xml = base64_encode_pem(xml);
       std::ofstream ofs(file_name);
@@ -249,105 +977,22 @@ namespace serializer {
 
     template <typename T>
     void deserialize_xml(T &t, const string &node_name, XMLElement *parent) {
-      _debug("deserialize_xml(T& t, const string &node_name, XMLElement *parent)");
-      XMLElement *elem = parent->FirstChildElement(node_name.c_str());
-      ASSERT(elem != nullptr);
-      if constexpr (is_supported_container_v<T>) {
-        _debug("is_supported_container_v<T>");
-        if constexpr (is_pair_v<T>) {
-          _debug("deserialize_xml: is_pair_v<T>");
-          deserialize_xml(std::get<0>(t), "first", elem);
-          deserialize_xml(std::get<1>(t), "second", elem);
-        } else if constexpr (is_array_container_v<T>) {
-          _debug("deserialize_xml: is_array_container_v<T>");
-          // child count
-          ASSERT(elem->Attribute("size") != nullptr);
-          const size_t size = std::stoul(elem->Attribute("size"));
-          // resize
-          t.resize(size);
-          size_t index = 0;
-          for (auto &el : t) {
-            deserialize_xml(el, string("_") + std::to_string(index++), elem);
-          }
-        } else if constexpr (is_tuple_v<T>) {
-          _debug("deserialize_xml: is_tuple_v<T>");
-          // Here we use foreach_in_tuple to iterate over the elements of the tuple at
-          // compile time, since std::get<i> is constexpr after C++14.
-          foreach_in_tuple(
-              t, [&](auto &el, const auto i) { deserialize_xml(el, string("_") + std::to_string(i), elem); });
-        } else if constexpr (is_map_container_v<T>) {
-          _debug("deserialize_xml: is_map_container_v<T>");
-          ASSERT(elem->Attribute("size") != nullptr);
-          const size_t size = std::stoul(elem->Attribute("size"));
-          for (size_t i = 0; i < size; i++) {
-            XMLElement *k = elem->FirstChildElement((string("_") + std::to_string(i) + "_k").c_str());
-            XMLElement *v = elem->FirstChildElement((string("_") + std::to_string(i) + "_v").c_str());
-            ASSERT(k != nullptr);
-            ASSERT(v != nullptr);
-            typename T::key_type key;
-            typename T::mapped_type value;
-            deserialize_xml(key, string("_") + std::to_string(i) + "_k", elem);
-            deserialize_xml(value, string("_") + std::to_string(i) + "_v", elem);
-            t.insert(std::make_pair(key, value));
-          }
-        } else if constexpr (is_set_container_v<T>) {
-          _debug("deserialize_xml: is_set_container_v<T>");
-          ASSERT(elem->Attribute("size") != nullptr);
-          const size_t size = std::stoul(elem->Attribute("size"));
-          for (size_t i = 0; i < size; i++) {
-            typename T::value_type value;
-            deserialize_xml(value, string("_") + std::to_string(i), elem);
-            t.insert(value);
-          }
-        } else {
-          constexpr auto x =
-              impossible_error(t, "T is a supported container type, but it's serializer is missing.");
-        }
-      } else if constexpr (is_supported_literal_v<T>) {
-        ASSERT(elem->Attribute("val") != nullptr);
-        if constexpr (is_cstring_v<T>) {
-          // Reading a string in this case so that we don't need to worry about memory allocation.
-          string s = from_string_value<string>(elem->Attribute("val"));
-          // The user should preallocate enough spaces for C-style strings.
-          memcpy(t, s.c_str(), s.size());
-        } else {
-          t = from_string_value<T>(elem->Attribute("val"));
-        }
-      } else if constexpr (std::is_base_of_v<XMLSerializable, remove_cv_t<T>>) {
-        _debug("deserialize_xml: is_base_of_v<XMLSerializable, remove_cv_t<T>>");
-        vector<string> args;
-        deserialize_xml(args, "udt", elem);
-        t.deserializeFromXML(args);
-      } else {
-        constexpr auto x =
-            impossible_error(t, "T is not a supported type, you must derive T from XMLSerializable");
-      }
+      TRACE("deserialize_xml(T& t, const string &node_name, XMLElement *parent)");
+      _throw_if_failed(try_deserialize_xml(t, node_name, parent));
     }
     template <typename T>
     void deserialize_xml(T &t, const string &node_name, const string &file_name) {
-      _debug("deserialize_xml(T& t, const string &node_name, const string &file_name)");
-      XMLDocument doc;
-      doc.LoadFile(file_name.c_str());
-      ASSERT(doc.ErrorID() == 0);
-      XMLElement *root = doc.FirstChildElement("serialization");
-      ASSERT(root != nullptr);
-      deserialize_xml(t, node_name, root);
-      doc.Clear();
+      TRACE("deserialize_xml(T& t, const string &node_name, const string &file_name)");
+      _throw_if_failed(try_deserialize_xml(t, node_name, file_name));
     }
     template <typename T>
     void deserialize_from_string_xml(T &t, const string &node_name, const string &xml_string) {
-      _debug("deserialize_from_string_xml(T& t, const string &node_name, const string &xml_string)");
-      XMLDocument doc;
-      doc.Parse(xml_string.c_str());
-      ASSERT(doc.ErrorID() == 0);
-      XMLElement *root = doc.FirstChildElement("serialization");
-      ASSERT(root != nullptr);
-      deserialize_xml(t, node_name, root);
-      doc.Clear();
+      TRACE("deserialize_from_string_xml(T& t, const string &node_name, const string &xml_string)");
+      _throw_if_failed(try_deserialize_from_string_xml(t, node_name, xml_string));
     }
     template <typename T>
     void deserialize_from_b64file_xml(T &t, const string &node_name, const string &file_name) {
-      _debug("deserialize_from_b64file_xml(T& t, const string &node_name, const string &file_name)");
+      TRACE("deserialize_from_b64file_xml(T& t, const string &node_name, const string &file_name)");
       std::ifstream ifs(file_name);
       ASSERT(ifs.is_open());
       std::stringstream b64_xml_ss;
@@ -355,5 +1000,35 @@ namespace serializer {
       string xml = base64_decode(b64_xml_ss.str(), true);
       deserialize_from_string_xml(t, node_name, xml);
     }
+
+    template <typename T>
+    XMLDecodeResult try_deserialize_xml(T &t, const string &node_name, const XMLElement *parent) {
+      TRACE("try_deserialize_xml(T& t, const string &node_name, const XMLElement *parent)");
+      METRICS_SCOPE(T, metrics::Op::deserialize_xml);
+      XMLDecodeResult r;
+      XMLErrorSite site;
+      r.code = _deserialize_xml(t, node_name.c_str(), parent, site, _document_layout(parent));
+      if (!r) {
+        _fill_path(r, site);
+      }
+      return r;
+    }
+    template <typename T>
+    XMLDecodeResult try_deserialize_xml(T &t, const string &node_name, const string &file_name) {
+      TRACE("try_deserialize_xml(T& t, const string &node_name, const string &file_name)");
+      METRICS_SCOPE(T, metrics::Op::deserialize_xml);
+      XMLDocument doc;
+      doc.LoadFile(file_name.c_str());
+      if (doc.ErrorID() == 0) {
+        METRICS_BYTES_IN(std::filesystem::file_size(file_name));
+      }
+      return _try_deserialize_document(t, node_name, doc);
+    }
+    template <typename T>
+    XMLDecodeResult try_deserialize_from_string_xml(T &t, const string &node_name, const string &xml_string) {
+      TRACE("try_deserialize_from_string_xml(T& t, const string &node_name, const string &xml_string)");
+      ThreadXMLContextScope ctx;
+      return ctx->try_deserialize_from_string(t, node_name, xml_string);
+    }
   } // namespace xml
 } // namespace serializer
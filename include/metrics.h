@@ -0,0 +1,295 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <istream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#if defined(__GNUG__)
+#include <cxxabi.h>
+#endif
+
+// Define enable_metrics as true (e.g. -Denable_metrics=true) to collect per-type metrics. When it
+// is false, METRICS_SCOPE(...) expands to an empty statement and nothing is recorded at all.
+#ifndef enable_metrics
+#define enable_metrics false
+#endif
+
+namespace serializer {
+  namespace metrics {
+    enum class Op { serialize, deserialize, serialize_xml, deserialize_xml };
+
+    inline const char *op_name(Op op) {
+      switch (op) {
+      case Op::serialize:
+        return "serialize";
+      case Op::deserialize:
+        return "deserialize";
+      case Op::serialize_xml:
+        return "serialize_xml";
+      case Op::deserialize_xml:
+        return "deserialize_xml";
+      }
+      return "unknown";
+    }
+
+    // Latencies are bucketed by their bit length, so bucket i holds latencies in [2^(i-1), 2^i) ns.
+    constexpr size_t latency_buckets = 64;
+
+    // Plain copy of a Counters, as returned by snapshot().
+    struct Entry {
+      Op op;
+      std::string type_name;
+      uint64_t calls;
+      uint64_t bytes_in;
+      uint64_t bytes_out;
+      uint64_t total_ns;
+      uint64_t allocations;
+      std::array<uint64_t, latency_buckets> histogram;
+
+      // Returns an upper bound of the p-th latency percentile (0 < p <= 1), in nanoseconds.
+      uint64_t percentile_ns(double p) const {
+        const uint64_t rank = static_cast<uint64_t>(p * calls + 0.5);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < latency_buckets; i++) {
+          seen += histogram[i];
+          if (seen >= rank && seen > 0) {
+            return i == 0 ? 0 : (i >= 63 ? UINT64_MAX : (uint64_t(1) << i) - 1);
+          }
+        }
+        return 0;
+      }
+      uint64_t mean_ns() const { return calls == 0 ? 0 : total_ns / calls; }
+    };
+
+    struct Counters {
+      std::atomic<uint64_t> calls{0};
+      std::atomic<uint64_t> bytes_in{0};
+      std::atomic<uint64_t> bytes_out{0};
+      std::atomic<uint64_t> total_ns{0};
+      std::atomic<uint64_t> allocations{0};
+      std::array<std::atomic<uint64_t>, latency_buckets> histogram{};
+
+      void add(uint64_t ns, uint64_t in, uint64_t out, uint64_t allocs) {
+        calls.fetch_add(1, std::memory_order_relaxed);
+        bytes_in.fetch_add(in, std::memory_order_relaxed);
+        bytes_out.fetch_add(out, std::memory_order_relaxed);
+        total_ns.fetch_add(ns, std::memory_order_relaxed);
+        allocations.fetch_add(allocs, std::memory_order_relaxed);
+        size_t bucket = 0;
+        while (ns != 0 && bucket < latency_buckets - 1) {
+          ns >>= 1;
+          bucket++;
+        }
+        histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+      }
+      void clear() {
+        calls = 0;
+        bytes_in = 0;
+        bytes_out = 0;
+        total_ns = 0;
+        allocations = 0;
+        for (auto &h : histogram) {
+          h = 0;
+        }
+      }
+    };
+
+    inline std::string demangle(const char *name) {
+#if defined(__GNUG__)
+      int status = 0;
+      std::unique_ptr<char, void (*)(void *)> result(abi::__cxa_demangle(name, nullptr, nullptr, &status),
+                                                     std::free);
+      if (status == 0 && result) {
+        return std::string(result.get());
+      }
+#endif
+      return std::string(name);
+    }
+
+    class Registry {
+    public:
+      // The returned reference stays valid for the lifetime of the program, so callers may cache it.
+      Counters &get(Op op, const std::string &type_name) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::unique_ptr<Counters> &c = counters_[{type_name, op}];
+        if (!c) {
+          c = std::make_unique<Counters>();
+        }
+        return *c;
+      }
+      std::vector<Entry> snapshot() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<Entry> result;
+        result.reserve(counters_.size());
+        for (const auto &[key, c] : counters_) {
+          Entry e{key.second, key.first, c->calls.load(), c->bytes_in.load(), c->bytes_out.load(),
+                  c->total_ns.load(), c->allocations.load(), {}};
+          for (size_t i = 0; i < latency_buckets; i++) {
+            e.histogram[i] = c->histogram[i].load();
+          }
+          result.push_back(std::move(e));
+        }
+        return result;
+      }
+      // Counters are zeroed rather than removed, so references handed out by get() stay valid.
+      void reset() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &[key, c] : counters_) {
+          c->clear();
+        }
+      }
+
+    private:
+      std::mutex mutex_;
+      std::map<std::pair<std::string, Op>, std::unique_ptr<Counters>> counters_;
+    };
+
+    inline Registry &registry() {
+      static Registry r;
+      return r;
+    }
+
+    // Number of heap allocations made by the calling thread. Only counted when the allocation
+    // hooks are installed, see METRICS_INSTALL_ALLOCATION_HOOKS below.
+    inline uint64_t &thread_allocations() {
+      thread_local uint64_t n = 0;
+      return n;
+    }
+
+    // Nesting depth of Scopes on the calling thread, shared by all types.
+    inline int &depth() {
+      thread_local int d = 0;
+      return d;
+    }
+
+    // Returns the metrics of every (operation, type) pair seen so far.
+    inline std::vector<Entry> snapshot() { return registry().snapshot(); }
+    inline void reset() { registry().reset(); }
+
+    inline void dump(std::ostream &os) {
+      os << std::left << std::setw(16) << "op" << std::setw(10) << "calls" << std::setw(14) << "bytes_in"
+         << std::setw(14) << "bytes_out" << std::setw(12) << "mean_ns" << std::setw(12) << "p50_ns"
+         << std::setw(12) << "p99_ns" << std::setw(10) << "allocs"
+         << "type" << '\n';
+      for (const Entry &e : snapshot()) {
+        os << std::left << std::setw(16) << op_name(e.op) << std::setw(10) << e.calls << std::setw(14) << e.bytes_in
+           << std::setw(14) << e.bytes_out << std::setw(12) << e.mean_ns() << std::setw(12) << e.percentile_ns(0.5)
+           << std::setw(12) << e.percentile_ns(0.99) << std::setw(10) << e.allocations << e.type_name << '\n';
+      }
+    }
+
+    // Measures one top-level call of an entry point instantiated with T. Entry points recurse into
+    // themselves for every element, so only the outermost Scope of each thread records anything;
+    // nested ones just bump the depth.
+    template <typename T>
+    class Scope {
+    public:
+      explicit Scope(Op op) : op_(op), outermost_(depth()++ == 0) {
+        if (outermost_) {
+          allocations_ = thread_allocations();
+          start_ = std::chrono::steady_clock::now();
+        }
+      }
+      Scope(Op op, std::ostream &os) : Scope(op) {
+        if (outermost_) {
+          os_ = &os;
+          pos_ = static_cast<int64_t>(os.tellp());
+        }
+      }
+      Scope(Op op, std::istream &is) : Scope(op) {
+        if (outermost_) {
+          is_ = &is;
+          pos_ = static_cast<int64_t>(is.tellg());
+        }
+      }
+      ~Scope() {
+        depth()--;
+        if (!outermost_) {
+          return;
+        }
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_);
+        if (os_ != nullptr && pos_ >= 0 && os_->good()) {
+          bytes_out_ += static_cast<int64_t>(os_->tellp()) - pos_;
+        }
+        if (is_ != nullptr && pos_ >= 0 && is_->good()) {
+          bytes_in_ += static_cast<int64_t>(is_->tellg()) - pos_;
+        }
+        counters(op_).add(ns.count(), bytes_in_, bytes_out_, thread_allocations() - allocations_);
+      }
+      Scope(const Scope &) = delete;
+      Scope &operator=(const Scope &) = delete;
+
+      // For entry points that know their input or output size without a stream.
+      void add_bytes_in(uint64_t n) { bytes_in_ += n; }
+      void add_bytes_out(uint64_t n) { bytes_out_ += n; }
+
+    private:
+      static Counters &counters(Op op) {
+        static const std::string name = demangle(typeid(T).name());
+        static std::atomic<Counters *> cache[4] = {};
+        // Threads that race here get the same pointer from the registry, which is locked.
+        std::atomic<Counters *> &cached = cache[static_cast<int>(op)];
+        Counters *c = cached.load(std::memory_order_acquire);
+        if (c == nullptr) {
+          c = &registry().get(op, name);
+          cached.store(c, std::memory_order_release);
+        }
+        return *c;
+      }
+
+      Op op_;
+      bool outermost_;
+      std::chrono::steady_clock::time_point start_;
+      uint64_t allocations_ = 0;
+      std::ostream *os_ = nullptr;
+      std::istream *is_ = nullptr;
+      int64_t pos_ = -1;
+      uint64_t bytes_in_ = 0;
+      uint64_t bytes_out_ = 0;
+    };
+  } // namespace metrics
+} // namespace serializer
+
+#if enable_metrics
+// Declares a metrics scope named _metrics_scope for the current entry point.
+#define METRICS_SCOPE(T, ...) ::serializer::metrics::Scope<T> _metrics_scope(__VA_ARGS__)
+#define METRICS_BYTES_IN(n) _metrics_scope.add_bytes_in(n)
+#define METRICS_BYTES_OUT(n) _metrics_scope.add_bytes_out(n)
+#else
+#define METRICS_SCOPE(...) \
+  do { \
+  } while (0)
+#define METRICS_BYTES_IN(n) \
+  do { \
+  } while (0)
+#define METRICS_BYTES_OUT(n) \
+  do { \
+  } while (0)
+#endif
+
+// Replacing the global allocation functions must happen in exactly one translation unit, so this
+// is left to the user: expand METRICS_INSTALL_ALLOCATION_HOOKS() once at namespace scope to have
+// allocations counted per call.
+#define METRICS_INSTALL_ALLOCATION_HOOKS() \
+  void *operator new(std::size_t size) { \
+    ::serializer::metrics::thread_allocations()++; \
+    if (void *p = std::malloc(size == 0 ? 1 : size)) { \
+      return p; \
+    } \
+    throw std::bad_alloc(); \
+  } \
+  void operator delete(void *p) noexcept { std::free(p); } \
+  void operator delete(void *p, std::size_t) noexcept { std::free(p); }
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace serializer {
+  // A bounded, lock-free queue for any number of producer threads and a single consumer thread.
+  // Every slot carries a sequence number that tells producers and the consumer whose turn it is,
+  // so neither side ever takes a lock. See also:
+  // https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+  template <typename T>
+  class BoundedMPSCQueue {
+  public:
+    // The capacity is rounded up to a power of two.
+    explicit BoundedMPSCQueue(size_t capacity) {
+      size_t n = 2;
+      while (n < capacity) {
+        n <<= 1;
+      }
+      mask_ = n - 1;
+      cells_.reset(new Cell[n]);
+      for (size_t i = 0; i < n; i++) {
+        cells_[i].seq.store(i, std::memory_order_relaxed);
+      }
+    }
+    BoundedMPSCQueue(const BoundedMPSCQueue &) = delete;
+    BoundedMPSCQueue &operator=(const BoundedMPSCQueue &) = delete;
+
+    size_t capacity() const { return mask_ + 1; }
+    // Number of pushes that have claimed a slot so far. The consumer pops in this order.
+    size_t pushed() const { return tail_.load(); }
+
+    // Returns false, and leaves v alone, if the queue is full. Safe to call from any thread.
+    bool try_push(T &v) {
+      size_t pos = tail_.load(std::memory_order_relaxed);
+      Cell *cell;
+      for (;;) {
+        cell = &cells_[pos & mask_];
+        const size_t seq = cell->seq.load(std::memory_order_acquire);
+        const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+          if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+            break;
+          }
+        } else if (diff < 0) {
+          return false;
+        } else {
+          pos = tail_.load(std::memory_order_relaxed);
+        }
+      }
+      cell->value = std::move(v);
+      cell->seq.store(pos + 1, std::memory_order_release);
+      return true;
+    }
+
+    // Returns false if the queue is empty. Must only be called from the consumer thread.
+    bool try_pop(T &v) {
+      Cell &cell = cells_[head_ & mask_];
+      if (cell.seq.load(std::memory_order_acquire) != head_ + 1) {
+        return false;
+      }
+      v = std::move(cell.value);
+      cell.seq.store(head_ + mask_ + 1, std::memory_order_release);
+      head_++;
+      return true;
+    }
+
+  private:
+    struct Cell {
+      std::atomic<size_t> seq;
+      T value;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_;
+    // Producers and the consumer work on different ends, so keep them on different cache lines.
+    alignas(64) std::atomic<size_t> tail_{0};
+    alignas(64) size_t head_ = 0;
+  };
+} // namespace serializer
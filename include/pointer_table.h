@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace serializer {
+  // Identities of the objects behind the shared_ptrs seen during one serialize or deserialize call.
+  // Every object is written once, when it is first seen, and later occurrences become references to
+  // its id, so sharing and cycles survive a round trip.
+  struct PointerTable {
+    // Pointer references are encoded as a size_t: null, an object that follows inline (and takes
+    // the next id), or back_ref + the id of an object seen before.
+    static constexpr size_t null_ref = 0;
+    static constexpr size_t new_ref = 1;
+    static constexpr size_t back_ref = 2;
+
+    // ids of the objects written so far, by address
+    std::unordered_map<const void *, size_t> written;
+    // objects read so far, by id, with their types to reject references of the wrong type
+    std::vector<std::pair<std::shared_ptr<void>, const std::type_info *>> read;
+  };
+
+  // The table of the serialize or deserialize call running on this thread, or nullptr if there is
+  // none. Like current_decode_context(), this is not in an anonymous namespace, so that the nested
+  // calls of user-defined types compiled in other translation units share the same table.
+  inline PointerTable *&current_pointer_table() {
+    thread_local PointerTable *table = nullptr;
+    return table;
+  }
+
+  // Installs a PointerTable for the lifetime of this object, unless one is installed already.
+  class PointerScope {
+  public:
+    PointerScope() {
+      if (current_pointer_table() == nullptr) {
+        current_pointer_table() = &table_.emplace();
+      }
+    }
+    ~PointerScope() {
+      if (table_) {
+        current_pointer_table() = nullptr;
+      }
+    }
+    PointerScope(const PointerScope &) = delete;
+    PointerScope &operator=(const PointerScope &) = delete;
+
+  private:
+    std::optional<PointerTable> table_;
+  };
+} // namespace serializer
@@ -1749,6 +1749,16 @@ public:
     */
     XMLError Parse( const char* xml, size_t nBytes=static_cast<size_t>(-1) );
 
+    /**
+    	Parse an XML file from a character buffer in place, without copying it.
+    	Returns XML_SUCCESS (0) on success, or an errorID.
+
+    	The buffer must hold 'nBytes' characters followed by a null terminator.
+    	Parsing modifies it, and the nodes of the document point into it, so it
+    	must outlive the document, or its next Parse, LoadFile or Clear.
+    */
+    XMLError ParseInPlace( char* xml, size_t nBytes );
+
     /**
     	Load an XML file from disk.
     	Returns XML_SUCCESS (0) on success, or
@@ -1938,6 +1948,7 @@ private:
     mutable StrPair	_errorStr;
     int             _errorLineNum;
     char*			_charBuffer;
+    bool			_charBufferOwned;	// false after ParseInPlace
     int				_parseCurLineNum;
 	int				_parsingDepth;
 	// Memory tracking does add some overhead.
@@ -8,3 +8,6 @@ wget -O - https://raw.githubusercontent.com/leethomason/tinyxml2/master/LICENSE.
 wget -O - https://raw.githubusercontent.com/ReneNyffenegger/cpp-base64/master/base64.h > base64.h
 wget -O - https://raw.githubusercontent.com/ReneNyffenegger/cpp-base64/master/base64.cpp > base64.cpp
 wget -O - https://raw.githubusercontent.com/ReneNyffenegger/cpp-base64/master/LICENSE > cpp-base64_LICENSE
+
+# ParseInPlace, used by xml_in_place.h
+patch -p0 < tinyxml2_in_place.patch
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace serializer {
+  // A fixed set of worker threads running tasks in the order they were posted.
+  class ThreadPool {
+  public:
+    // 0 threads means std::thread::hardware_concurrency().
+    explicit ThreadPool(size_t threads) {
+      if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+      }
+      workers_.reserve(threads);
+      for (size_t i = 0; i < threads; i++) {
+        workers_.emplace_back([this] { run(); });
+      }
+    }
+    // Runs the tasks still queued, then joins the workers.
+    ~ThreadPool() {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+      }
+      cv_.notify_all();
+      for (std::thread &worker : workers_) {
+        worker.join();
+      }
+    }
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    size_t size() const { return workers_.size(); }
+
+    // Exceptions thrown by the task are dropped.
+    void post(std::function<void()> task) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+      }
+      cv_.notify_one();
+    }
+    // Runs f on the pool. The future holds its result, or the exception it threw.
+    template <typename F>
+    std::future<std::invoke_result_t<F>> submit(F f) {
+      // std::function needs a copyable target, so the task is held through a shared_ptr.
+      auto task = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::move(f));
+      std::future<std::invoke_result_t<F>> future = task->get_future();
+      post([task] { (*task)(); });
+      return future;
+    }
+
+  private:
+    void run() {
+      for (;;) {
+        std::function<void()> task;
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          cv_.wait(lock, [&] { return stopping_ || !tasks_.empty(); });
+          if (tasks_.empty()) {
+            return;
+          }
+          task = std::move(tasks_.front());
+          tasks_.pop_front();
+        }
+        // A task that throws must not take the worker, and the process, down with it. submit
+        // reports exceptions through the future, and there is nobody else to report them to.
+        try {
+          task();
+        } catch (...) {
+        }
+      }
+    }
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::function<void()>> tasks_;
+    bool stopping_ = false;
+  };
+
+  // Not in an anonymous namespace, so that all translation units share one pool.
+  struct ThreadPoolConfig {
+    std::mutex mutex;
+    size_t threads = 0;
+    std::unique_ptr<ThreadPool> pool;
+  };
+  inline ThreadPoolConfig &thread_pool_config() {
+    static ThreadPoolConfig config;
+    return config;
+  }
+
+  // Sets the number of threads of the pool behind the *_async entry points (0, the default, means
+  // one per hardware thread). Returns false, and changes nothing, once the pool has been started.
+  inline bool set_thread_pool_size(size_t threads) {
+    ThreadPoolConfig &config = thread_pool_config();
+    std::lock_guard<std::mutex> lock(config.mutex);
+    if (config.pool) {
+      return false;
+    }
+    config.threads = threads;
+    return true;
+  }
+
+  // The pool behind the *_async entry points, started on first use.
+  inline ThreadPool &thread_pool() {
+    ThreadPoolConfig &config = thread_pool_config();
+    std::lock_guard<std::mutex> lock(config.mutex);
+    if (!config.pool) {
+      config.pool = std::make_unique<ThreadPool>(config.threads);
+    }
+    return *config.pool;
+  }
+} // namespace serializer
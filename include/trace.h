@@ -0,0 +1,91 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Define is_debug as true (e.g. -Dis_debug=true) to turn tracing on. When it is false, TRACE(...)
+// expands to an empty statement, so its arguments are never evaluated and no code is generated.
+#ifndef is_debug
+#define is_debug false
+#endif
+
+// Number of records kept per thread. Older records are overwritten once the ring is full.
+#ifndef TRACE_CAPACITY
+#define TRACE_CAPACITY 1024
+#endif
+
+// Records longer than this are truncated.
+#ifndef TRACE_MESSAGE_SIZE
+#define TRACE_MESSAGE_SIZE 128
+#endif
+
+namespace serializer {
+  namespace trace {
+    struct Record {
+      uint64_t seq;
+      char message[TRACE_MESSAGE_SIZE];
+    };
+
+    // A fixed-size ring of trace records. Recording never allocates and never touches stdout,
+    // so tracing can be left on under load. Each thread owns its own ring, see ring() below.
+    struct RingBuffer {
+      std::array<Record, TRACE_CAPACITY> records;
+      uint64_t next = 0;
+
+      Record &push() {
+        Record &r = records[next % TRACE_CAPACITY];
+        r.seq = next++;
+        return r;
+      }
+      size_t size() const { return next < TRACE_CAPACITY ? next : TRACE_CAPACITY; }
+    };
+
+    inline RingBuffer &ring() {
+      thread_local RingBuffer r;
+      return r;
+    }
+
+    inline void record(const char *message) {
+      Record &r = ring().push();
+      strncpy(r.message, message, TRACE_MESSAGE_SIZE - 1);
+      r.message[TRACE_MESSAGE_SIZE - 1] = '\0';
+    }
+    // printf-style formatting, so that callers don't have to build std::strings to trace a value.
+    template <typename... Args>
+    void record(const char *format, Args... args) {
+      Record &r = ring().push();
+      snprintf(r.message, TRACE_MESSAGE_SIZE, format, args...);
+    }
+
+    // Returns the records of the calling thread, oldest first.
+    inline std::vector<std::string> snapshot() {
+      const RingBuffer &r = ring();
+      std::vector<std::string> result;
+      result.reserve(r.size());
+      for (uint64_t seq = r.next - r.size(); seq < r.next; seq++) {
+        result.emplace_back(r.records[seq % TRACE_CAPACITY].message);
+      }
+      return result;
+    }
+    inline void dump(std::ostream &os) {
+      const RingBuffer &r = ring();
+      for (uint64_t seq = r.next - r.size(); seq < r.next; seq++) {
+        os << "[" << seq << "] " << r.records[seq % TRACE_CAPACITY].message << '\n';
+      }
+    }
+    inline void clear() { ring().next = 0; }
+  } // namespace trace
+} // namespace serializer
+
+#if is_debug
+#define TRACE(...) ::serializer::trace::record(__VA_ARGS__)
+#else
+#define TRACE(...) \
+  do { \
+  } while (0)
+#endif
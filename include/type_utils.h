@@ -1,9 +1,11 @@
 #pragma once
 
+#include <bitset>
 #include <initializer_list>
 #include <iostream>
 #include <list>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <tuple>
@@ -11,29 +13,12 @@
 #include <unordered_map>
 #include <vector>
 
-#ifndef is_debug
-#define is_debug false
-#endif
+#include "trace.h"
 
 using std::remove_cv_t;
 using std::string;
 
 namespace serializer {
-  // anonymous namespace for private-like helper functions, i.e. _debug
-  namespace {
-    template <typename T>
-    void _debug(T t, bool newline = true) {
-      if (is_debug) {
-        std::cout << t;
-        if (newline) {
-          std::cout << std::endl;
-        } else {
-          std::cout << " ";
-        }
-      }
-    }
-  } // namespace
-
   namespace {
     // Modified from https://stackoverflow.com/a/16397153/8553479
 
@@ -123,6 +108,61 @@ namespace serializer {
   template <typename T>
   constexpr auto is_array_container_v = A<remove_cv_t<T>>::v;
 
+  // Check if a type is a std::vector<bool>, whose elements are stored as packed bits.
+  namespace {
+    // fallback struct:
+    template <class T>
+    struct VB {
+      static constexpr bool v = false;
+    };
+    template <class Alloc>
+    struct VB<std::vector<bool, Alloc>> {
+      static constexpr bool v = true;
+    };
+  } // namespace
+  template <typename T>
+  constexpr auto is_bool_vector_v = VB<remove_cv_t<T>>::v;
+
+  // Check if a type is a std::bitset.
+  namespace {
+    // fallback struct:
+    template <class T>
+    struct BS {
+      static constexpr bool v = false;
+    };
+    template <size_t N>
+    struct BS<std::bitset<N>> {
+      static constexpr bool v = true;
+    };
+  } // namespace
+  template <typename T>
+  constexpr auto is_bitset_v = BS<remove_cv_t<T>>::v;
+
+  // Check if a type is a std::shared_ptr or a std::unique_ptr to a single object.
+  namespace {
+    // fallback struct:
+    template <class T>
+    struct SP {
+      static constexpr bool shared = false;
+      static constexpr bool unique = false;
+    };
+    template <typename T>
+    struct SP<std::shared_ptr<T>> {
+      static constexpr bool shared = !std::is_array_v<T>;
+      static constexpr bool unique = false;
+    };
+    // Only with the default deleter, since deserialize has to create the object.
+    template <typename T>
+    struct SP<std::unique_ptr<T>> {
+      static constexpr bool shared = false;
+      static constexpr bool unique = !std::is_array_v<T>;
+    };
+  } // namespace
+  template <typename T>
+  constexpr auto is_shared_ptr_v = SP<remove_cv_t<T>>::shared;
+  template <typename T>
+  constexpr auto is_unique_ptr_v = SP<remove_cv_t<T>>::unique;
+
   // Check if a type is a map-like container. That is, any container with key_type and mapped_type
   // inferable from std::pair and supports operator[] is accepted.
   // See also: https://en.cppreference.com/w/cpp/container/map
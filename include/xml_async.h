@@ -0,0 +1,61 @@
+#pragma once
+
+#include <functional>
+#include <future>
+#include <string>
+#include <utility>
+
+#include "errors.h"
+#include "libxml.h"
+#include "thread_pool.h"
+
+// Asynchronous variants of the XML entry points, running on serializer::thread_pool().
+//
+// The object passed in is used by reference: it must stay alive, and must not be touched by the
+// caller, until the future is ready or the callback has been called.
+
+namespace serializer {
+  namespace xml {
+    // declarations
+    template <typename T>
+    std::future<void> serialize_xml_async(const T &t, string node_name, string file_name);
+    // The future rethrows what deserialize_xml throws.
+    template <typename T>
+    std::future<void> deserialize_xml_async(T &t, string node_name, string file_name);
+    // Calls done with the result of try_deserialize_xml, on a pool thread. If decoding throws, the
+    // result is DecodeErrc::exception_thrown.
+    template <typename T>
+    void deserialize_xml_async(T &t, string node_name, string file_name, std::function<void(XMLDecodeResult)> done);
+
+    // definitions
+    template <typename T>
+    std::future<void> serialize_xml_async(const T &t, string node_name, string file_name) {
+      TRACE("serialize_xml_async(const T& t, string node_name, string file_name)");
+      return thread_pool().submit([&t, node_name = std::move(node_name), file_name = std::move(file_name)] {
+        serialize_xml(t, node_name, file_name);
+      });
+    }
+    template <typename T>
+    std::future<void> deserialize_xml_async(T &t, string node_name, string file_name) {
+      TRACE("deserialize_xml_async(T& t, string node_name, string file_name)");
+      return thread_pool().submit([&t, node_name = std::move(node_name), file_name = std::move(file_name)] {
+        deserialize_xml(t, node_name, file_name);
+      });
+    }
+    template <typename T>
+    void deserialize_xml_async(T &t, string node_name, string file_name, std::function<void(XMLDecodeResult)> done) {
+      TRACE("deserialize_xml_async(T& t, string node_name, string file_name, std::function<void(XMLDecodeResult)> done)");
+      thread_pool().post(
+          [&t, node_name = std::move(node_name), file_name = std::move(file_name), done = std::move(done)] {
+            XMLDecodeResult r;
+            try {
+              r = try_deserialize_xml(t, node_name, file_name);
+            } catch (...) {
+              r = XMLDecodeResult{};
+              r.code = DecodeErrc::exception_thrown;
+            }
+            done(r);
+          });
+    }
+  } // namespace xml
+} // namespace serializer
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SERIALIZER_XML_MMAP 1
+#else
+#define SERIALIZER_XML_MMAP 0
+#endif
+
+#include "common.h"
+#include "errors.h"
+#include "libxml.h"
+
+// Decoding XML without copying the input first.
+//
+// tinyxml2 normally copies the text it parses into a buffer of its own, and then writes into that
+// copy (the terminators of names and values, and decoded entities). The functions here have it
+// parse a buffer of the caller in place instead, or a private copy-on-write mapping of a file, so
+// that the whole input never exists twice. Parsing still writes to most pages of a mapping, which
+// are then copied by the kernel one by one, but reading the file into a fresh buffer is skipped.
+
+namespace serializer {
+  namespace xml {
+    namespace {
+      // A private, writable view of a file, followed by a '\0'. Without mmap, the file is read into
+      // a buffer instead.
+      class XMLFileBuffer {
+      public:
+        XMLFileBuffer() = default;
+        ~XMLFileBuffer() { close(); }
+        XMLFileBuffer(const XMLFileBuffer &) = delete;
+        XMLFileBuffer &operator=(const XMLFileBuffer &) = delete;
+
+        bool open(const string &file_name) {
+          TRACE("XMLFileBuffer::open(const string &file_name)");
+          close();
+#if SERIALIZER_XML_MMAP
+          const int fd = ::open(file_name.c_str(), O_RDONLY);
+          if (fd < 0) {
+            return false;
+          }
+          struct stat st;
+          if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+          }
+          size_ = st.st_size;
+          // The anonymous pages past the end of the file hold the terminator, even when the size
+          // of the file is a multiple of the page size.
+          const size_t page = sysconf(_SC_PAGESIZE);
+          mapped_size_ = (size_ + page) / page * page;
+          void *p = mmap(nullptr, mapped_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+          if (p == MAP_FAILED) {
+            ::close(fd);
+            return false;
+          }
+          data_ = static_cast<char *>(p);
+          if (size_ != 0 && mmap(data_, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+            ::close(fd);
+            close();
+            return false;
+          }
+          ::close(fd);
+#else
+          std::ifstream is(file_name, std::ios::binary | std::ios::ate);
+          if (!is.good()) {
+            return false;
+          }
+          size_ = is.tellg();
+          data_ = new char[size_ + 1];
+          is.seekg(0);
+          is.read(data_, size_);
+          data_[size_] = '\0';
+#endif
+          return true;
+        }
+        void close() {
+          if (data_ != nullptr) {
+#if SERIALIZER_XML_MMAP
+            munmap(data_, mapped_size_);
+#else
+            delete[] data_;
+#endif
+          }
+          data_ = nullptr;
+          size_ = 0;
+        }
+
+        char *data() const { return data_; }
+        size_t size() const { return size_; }
+
+      private:
+        char *data_ = nullptr;
+        size_t size_ = 0;
+        size_t mapped_size_ = 0;
+      };
+    } // namespace
+
+    // declarations
+    // Decodes the document in xml, which must hold size characters followed by a '\0', by parsing
+    // it in place. The contents of xml are overwritten.
+    template <typename T>
+    XMLDecodeResult try_deserialize_xml_in_place(T &t, const string &node_name, char *xml, size_t size);
+    template <typename T>
+    XMLDecodeResult try_deserialize_xml_in_place(T &t, const string &node_name, string &xml);
+    template <typename T>
+    void deserialize_xml_in_place(T &t, const string &node_name, char *xml, size_t size);
+    template <typename T>
+    void deserialize_xml_in_place(T &t, const string &node_name, string &xml);
+    // Decodes a file by parsing a private copy-on-write mapping of it in place. The file itself is
+    // left unchanged.
+    template <typename T>
+    XMLDecodeResult try_deserialize_xml_mmap(T &t, const string &node_name, const string &file_name);
+    template <typename T>
+    void deserialize_xml_mmap(T &t, const string &node_name, const string &file_name);
+
+    // definitions
+    template <typename T>
+    XMLDecodeResult try_deserialize_xml_in_place(T &t, const string &node_name, char *xml, size_t size) {
+      TRACE("try_deserialize_xml_in_place(T& t, const string &node_name, char *xml, size_t size)");
+      ThreadXMLContextScope ctx;
+      return ctx->try_deserialize_in_place(t, node_name, xml, size);
+    }
+    template <typename T>
+    XMLDecodeResult try_deserialize_xml_in_place(T &t, const string &node_name, string &xml) {
+      TRACE("try_deserialize_xml_in_place(T& t, const string &node_name, string &xml)");
+      return try_deserialize_xml_in_place(t, node_name, xml.data(), xml.size());
+    }
+    template <typename T>
+    void deserialize_xml_in_place(T &t, const string &node_name, char *xml, size_t size) {
+      TRACE("deserialize_xml_in_place(T& t, const string &node_name, char *xml, size_t size)");
+      _throw_if_failed(try_deserialize_xml_in_place(t, node_name, xml, size));
+    }
+    template <typename T>
+    void deserialize_xml_in_place(T &t, const string &node_name, string &xml) {
+      TRACE("deserialize_xml_in_place(T& t, const string &node_name, string &xml)");
+      _throw_if_failed(try_deserialize_xml_in_place(t, node_name, xml));
+    }
+
+    template <typename T>
+    XMLDecodeResult try_deserialize_xml_mmap(T &t, const string &node_name, const string &file_name) {
+      TRACE("try_deserialize_xml_mmap(T& t, const string &node_name, const string &file_name)");
+      XMLFileBuffer buffer;
+      if (!buffer.open(file_name)) {
+        XMLDecodeResult r;
+        r.code = DecodeErrc::open_failed;
+        return r;
+      }
+      return try_deserialize_xml_in_place(t, node_name, buffer.data(), buffer.size());
+    }
+    template <typename T>
+    void deserialize_xml_mmap(T &t, const string &node_name, const string &file_name) {
+      TRACE("deserialize_xml_mmap(T& t, const string &node_name, const string &file_name)");
+      _throw_if_failed(try_deserialize_xml_mmap(t, node_name, file_name));
+    }
+  } // namespace xml
+} // namespace serializer
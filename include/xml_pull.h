@@ -0,0 +1,431 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common.h"
+#include "errors.h"
+#include "libxml.h"
+#include "type_utils.h"
+
+// Decoding XML while it is read, without building a tinyxml2 document.
+//
+// XMLPullParser scans the input one tag at a time and only keeps the attributes of the current
+// element and the names of the open ones, so memory is O(depth) rather than O(document). The
+// decoder walks the type of T and pulls the elements serialize_xml wrote for it, in the order it
+// wrote them. Unlike deserialize_xml, which looks children up by name, it skips elements it does
+// not expect but cannot go back to earlier ones, so reordered documents fail with missing_node.
+// Only the standard XMLLayout is supported.
+
+namespace serializer {
+  namespace xml {
+    // A forward-only XML tokenizer. Text, comments, processing instructions and DOCTYPE/CDATA
+    // sections are skipped, since the serializer stores everything in elements and attributes.
+    class XMLPullParser {
+    public:
+      enum Event { start_element, end_element, end_document, syntax_error };
+
+      explicit XMLPullParser(std::istream &is) : buf_(is.rdbuf()) {}
+
+      // Reads up to the next start or end tag. A self-closing element yields both events.
+      Event next() {
+        if (pending_end_) {
+          pending_end_ = false;
+          name_.swap(open_.back());
+          open_.pop_back();
+          return end_element;
+        }
+        for (;;) {
+          int c = get();
+          if (c == eof) {
+            return open_.empty() ? end_document : syntax_error;
+          }
+          if (c != '<') {
+            continue;
+          }
+          c = peek();
+          if (c == '?') {
+            if (!skip_past("?>")) {
+              return syntax_error;
+            }
+          } else if (c == '!') {
+            get();
+            const bool skipped = peek() == '-' ? skip_past("-->") : peek() == '[' ? skip_past("]]>") : skip_past(">");
+            if (!skipped) {
+              return syntax_error;
+            }
+          } else if (c == '/') {
+            get();
+            if (!read_name(name_) || !expect('>') || open_.empty() || open_.back() != name_) {
+              return syntax_error;
+            }
+            open_.pop_back();
+            return end_element;
+          } else {
+            return read_start_tag() ? start_element : syntax_error;
+          }
+        }
+      }
+      // After a start_element, reads up to and including its end_element.
+      Event skip() {
+        const size_t depth = open_.size();
+        for (;;) {
+          const Event e = next();
+          if (e == end_element && open_.size() + 1 == depth) {
+            return e;
+          }
+          if (e == end_document || e == syntax_error) {
+            return syntax_error;
+          }
+        }
+      }
+
+      // Name of the element of the last event.
+      const string &name() const { return name_; }
+      // Attribute of the element of the last start_element, or nullptr.
+      const char *attribute(const char *name) const {
+        for (size_t i = 0; i < attribute_count_; i++) {
+          if (attributes_[i].first == name) {
+            return attributes_[i].second.c_str();
+          }
+        }
+        return nullptr;
+      }
+      // Names of the open elements, outermost first.
+      const vector<string> &open_elements() const { return open_; }
+
+    private:
+      static constexpr int eof = std::char_traits<char>::eof();
+
+      int get() { return buf_->sbumpc(); }
+      int peek() { return buf_->sgetc(); }
+      static bool is_space(int c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+      void skip_spaces() {
+        while (is_space(peek())) {
+          get();
+        }
+      }
+      bool expect(char c) {
+        skip_spaces();
+        return get() == c;
+      }
+      bool skip_past(const char *terminator) {
+        const size_t n = strlen(terminator);
+        size_t matched = 0;
+        char window[4] = {};
+        for (int c = get(); c != eof; c = get()) {
+          // the last n characters read
+          memmove(window, window + 1, n - 1);
+          window[n - 1] = static_cast<char>(c);
+          if (++matched >= n && memcmp(window, terminator, n) == 0) {
+            return true;
+          }
+        }
+        return false;
+      }
+      bool read_name(string &name) {
+        name.clear();
+        for (int c = peek(); c != eof && !is_space(c) && c != '>' && c != '/' && c != '='; c = peek()) {
+          name.push_back(static_cast<char>(get()));
+        }
+        return !name.empty();
+      }
+      // Reads an attribute value up to the closing quote, replacing entity references.
+      bool read_value(char quote, string &value) {
+        value.clear();
+        for (int c = get(); c != quote; c = get()) {
+          if (c == eof) {
+            return false;
+          }
+          if (c != '&') {
+            value.push_back(static_cast<char>(c));
+            continue;
+          }
+          char entity[12];
+          size_t len = 0;
+          for (c = get(); c != ';'; c = get()) {
+            if (c == eof || len + 1 == sizeof(entity)) {
+              return false;
+            }
+            entity[len++] = static_cast<char>(c);
+          }
+          entity[len] = '\0';
+          if (!append_entity(entity, value)) {
+            return false;
+          }
+        }
+        return true;
+      }
+      static bool append_entity(const char *entity, string &value) {
+        static const std::pair<const char *, char> named[] = {
+            {"lt", '<'}, {"gt", '>'}, {"amp", '&'}, {"quot", '"'}, {"apos", '\''}};
+        for (const auto &[name, c] : named) {
+          if (strcmp(entity, name) == 0) {
+            value.push_back(c);
+            return true;
+          }
+        }
+        if (entity[0] != '#') {
+          return false;
+        }
+        char *end = nullptr;
+        const unsigned long code = entity[1] == 'x' ? strtoul(entity + 2, &end, 16) : strtoul(entity + 1, &end, 10);
+        if (end == nullptr || *end != '\0' || code > 0x10FFFF) {
+          return false;
+        }
+        // UTF-8
+        if (code < 0x80) {
+          value.push_back(static_cast<char>(code));
+        } else if (code < 0x800) {
+          value.push_back(static_cast<char>(0xC0 | (code >> 6)));
+          value.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        } else if (code < 0x10000) {
+          value.push_back(static_cast<char>(0xE0 | (code >> 12)));
+          value.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+          value.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        } else {
+          value.push_back(static_cast<char>(0xF0 | (code >> 18)));
+          value.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+          value.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+          value.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        }
+        return true;
+      }
+      bool read_start_tag() {
+        if (!read_name(name_)) {
+          return false;
+        }
+        // The strings of the attributes are reused from element to element.
+        attribute_count_ = 0;
+        for (;;) {
+          skip_spaces();
+          const int c = peek();
+          if (c == '>' || c == '/') {
+            get();
+            if (c == '/' && get() != '>') {
+              return false;
+            }
+            pending_end_ = c == '/';
+            open_.push_back(name_);
+            return true;
+          }
+          if (attribute_count_ == attributes_.size()) {
+            attributes_.emplace_back();
+          }
+          auto &[name, value] = attributes_[attribute_count_++];
+          if (!read_name(name) || !expect('=')) {
+            return false;
+          }
+          skip_spaces();
+          const int quote = get();
+          if ((quote != '"' && quote != '\'') || !read_value(static_cast<char>(quote), value)) {
+            return false;
+          }
+        }
+      }
+
+      std::streambuf *buf_;
+      string name_;
+      vector<std::pair<string, string>> attributes_;
+      size_t attribute_count_ = 0;
+      vector<string> open_;
+      bool pending_end_ = false;
+    };
+
+    // declarations
+    template <typename T>
+    XMLDecodeResult try_deserialize_xml_pull(T &t, const string &node_name, std::istream &is);
+    template <typename T>
+    XMLDecodeResult try_deserialize_xml_pull(T &t, const string &node_name, const string &file_name);
+    template <typename T>
+    void deserialize_xml_pull(T &t, const string &node_name, std::istream &is);
+    template <typename T>
+    void deserialize_xml_pull(T &t, const string &node_name, const string &file_name);
+
+    namespace {
+      // Records the path of the open elements, then the missing child or attribute, if any.
+      inline DecodeErrc _pull_fail(XMLDecodeResult &r, DecodeErrc e, const XMLPullParser &p,
+                                   const char *missing = nullptr) {
+        size_t len = 0;
+        r.path[0] = '\0';
+        for (const string &name : p.open_elements()) {
+          _append(r.path, sizeof(r.path), len, name.c_str());
+          _append(r.path, sizeof(r.path), len, "/");
+        }
+        if (missing != nullptr) {
+          _append(r.path, sizeof(r.path), len, missing);
+        } else if (len > 0) {
+          r.path[--len] = '\0';
+        }
+        return e;
+      }
+
+      // Reads up to the start of the child of the current element named name, skipping the others.
+      inline DecodeErrc _pull_child(XMLPullParser &p, const char *name, XMLDecodeResult &r) {
+        for (;;) {
+          switch (p.next()) {
+          case XMLPullParser::start_element:
+            if (p.name() == name) {
+              return DecodeErrc::ok;
+            }
+            if (p.skip() != XMLPullParser::end_element) {
+              return _pull_fail(r, DecodeErrc::open_failed, p);
+            }
+            break;
+          case XMLPullParser::end_element: {
+            // The parent is closed already, so it is put back into the path.
+            string missing = p.name() + "/" + name;
+            return _pull_fail(r, DecodeErrc::missing_node, p, missing.c_str());
+          }
+          default:
+            return _pull_fail(r, DecodeErrc::open_failed, p);
+          }
+        }
+      }
+
+      inline DecodeErrc _pull_size(XMLPullParser &p, size_t &size, XMLDecodeResult &r) {
+        const char *attr = p.attribute("size");
+        if (attr == nullptr) {
+          return _pull_fail(r, DecodeErrc::missing_node, p, "@size");
+        }
+        if (!parse_literal(attr, size)) {
+          return _pull_fail(r, DecodeErrc::bad_literal, p, "@size");
+        }
+        return DecodeErrc::ok;
+      }
+
+      // Decodes the child of the current element named node_name, in the layout of serialize_xml.
+      template <typename T>
+      DecodeErrc _deserialize_xml_pull(T &t, const char *node_name, XMLPullParser &p, XMLDecodeResult &r) {
+        TRACE("_deserialize_xml_pull(T& t, const char* node_name, XMLPullParser& p, XMLDecodeResult& r)");
+        RETURN_IF_ERROR(_pull_child(p, node_name, r));
+        if constexpr (is_supported_container_v<T>) {
+          char name[32];
+          if constexpr (is_pair_v<T>) {
+            RETURN_IF_ERROR(_deserialize_xml_pull(std::get<0>(t), "first", p, r));
+            RETURN_IF_ERROR(_deserialize_xml_pull(std::get<1>(t), "second", p, r));
+          } else if constexpr (is_array_container_v<T>) {
+            size_t size;
+            RETURN_IF_ERROR(_pull_size(p, size, r));
+            t.resize(size);
+            size_t index = 0;
+            for (auto &el : t) {
+              snprintf(name, sizeof(name), "_%zu", index++);
+              RETURN_IF_ERROR(_deserialize_xml_pull(el, name, p, r));
+            }
+          } else if constexpr (is_tuple_v<T>) {
+            DecodeErrc e = DecodeErrc::ok;
+            foreach_in_tuple(t, [&](auto &el, const size_t i) {
+              if (e == DecodeErrc::ok) {
+                snprintf(name, sizeof(name), "_%zu", i);
+                e = _deserialize_xml_pull(el, name, p, r);
+              }
+            });
+            RETURN_IF_ERROR(e);
+          } else if constexpr (is_map_container_v<T>) {
+            size_t size;
+            RETURN_IF_ERROR(_pull_size(p, size, r));
+            for (size_t i = 0; i < size; i++) {
+              typename T::key_type key;
+              typename T::mapped_type value;
+              snprintf(name, sizeof(name), "_%zu_k", i);
+              RETURN_IF_ERROR(_deserialize_xml_pull(key, name, p, r));
+              snprintf(name, sizeof(name), "_%zu_v", i);
+              RETURN_IF_ERROR(_deserialize_xml_pull(value, name, p, r));
+              t.insert(std::make_pair(std::move(key), std::move(value)));
+            }
+          } else if constexpr (is_set_container_v<T>) {
+            size_t size;
+            RETURN_IF_ERROR(_pull_size(p, size, r));
+            for (size_t i = 0; i < size; i++) {
+              typename T::value_type value;
+              snprintf(name, sizeof(name), "_%zu", i);
+              RETURN_IF_ERROR(_deserialize_xml_pull(value, name, p, r));
+              t.insert(std::move(value));
+            }
+          } else {
+            static_assert(always_false<T>, "T is a supported container type, but it's serializer is missing.");
+          }
+        } else if constexpr (is_supported_literal_v<T>) {
+          const char *val = p.attribute("val");
+          if (val == nullptr) {
+            return _pull_fail(r, DecodeErrc::missing_node, p, "@val");
+          }
+          if constexpr (is_cstring_v<T>) {
+            // The user should preallocate enough spaces for C-style strings.
+            memcpy(t, val, strlen(val));
+          } else if constexpr (is_same_v<remove_cv_t<T>, string>) {
+            t = val;
+          } else if (!parse_literal(val, t)) {
+            return _pull_fail(r, DecodeErrc::bad_literal, p, "@val");
+          }
+        } else if constexpr (std::is_base_of_v<XMLSerializableV2, remove_cv_t<T>>) {
+          static_assert(always_false<T>, "XMLSerializableV2 types read from a DOM, use deserialize_xml instead");
+        } else if constexpr (std::is_base_of_v<XMLSerializable, remove_cv_t<T>>) {
+          vector<string> args;
+          RETURN_IF_ERROR(_deserialize_xml_pull(args, "udt", p, r));
+          t.deserializeFromXML(args);
+        } else {
+          static_assert(always_false<T>, "T is not a supported type, you must derive T from XMLSerializable");
+        }
+        // the rest of the element
+        if (p.skip() != XMLPullParser::end_element) {
+          return _pull_fail(r, DecodeErrc::open_failed, p);
+        }
+        return DecodeErrc::ok;
+      }
+    } // namespace
+
+    // definitions
+    template <typename T>
+    XMLDecodeResult try_deserialize_xml_pull(T &t, const string &node_name, std::istream &is) {
+      TRACE("try_deserialize_xml_pull(T& t, const string &node_name, std::istream& is)");
+      METRICS_SCOPE(T, metrics::Op::deserialize_xml);
+      XMLDecodeResult r;
+      XMLPullParser p(is);
+      const XMLPullParser::Event e = p.next();
+      if (e != XMLPullParser::start_element) {
+        r.code = DecodeErrc::open_failed;
+      } else if (p.name() != "serialization") {
+        r.code = DecodeErrc::missing_node;
+        size_t len = 0;
+        _append(r.path, sizeof(r.path), len, "serialization");
+      } else if (p.attribute("layout") != nullptr && strcmp(p.attribute("layout"), "standard") != 0) {
+        // only the standard layout is supported
+        r.code = DecodeErrc::bad_literal;
+        size_t len = 0;
+        _append(r.path, sizeof(r.path), len, "serialization/@layout");
+      } else {
+        r.code = _deserialize_xml_pull(t, node_name.c_str(), p, r);
+      }
+      return r;
+    }
+    template <typename T>
+    XMLDecodeResult try_deserialize_xml_pull(T &t, const string &node_name, const string &file_name) {
+      TRACE("try_deserialize_xml_pull(T& t, const string &node_name, const string &file_name)");
+      std::ifstream is(file_name, std::ios::binary);
+      if (!is.good()) {
+        XMLDecodeResult r;
+        r.code = DecodeErrc::open_failed;
+        return r;
+      }
+      return try_deserialize_xml_pull(t, node_name, is);
+    }
+    template <typename T>
+    void deserialize_xml_pull(T &t, const string &node_name, std::istream &is) {
+      TRACE("deserialize_xml_pull(T& t, const string &node_name, std::istream& is)");
+      _throw_if_failed(try_deserialize_xml_pull(t, node_name, is));
+    }
+    template <typename T>
+    void deserialize_xml_pull(T &t, const string &node_name, const string &file_name) {
+      TRACE("deserialize_xml_pull(T& t, const string &node_name, const string &file_name)");
+      _throw_if_failed(try_deserialize_xml_pull(t, node_name, file_name));
+    }
+  } // namespace xml
+} // namespace serializer
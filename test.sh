@@ -13,7 +13,7 @@ make -j || exit 1
 
 cd ./tests
 
-SERIALIZE_TEST_PASSED_COUNT=3
+SERIALIZE_TEST_PASSED_COUNT=4
 
 echo "[test_daemon] Running tests..."
 time ./test_binary || SERIALIZE_TEST_PASSED_COUNT=$(($SERIALIZE_TEST_PASSED_COUNT-1))
@@ -21,9 +21,11 @@ read -p "Press [Enter] to continue testing... (enter)"
 time ./test_xml || SERIALIZE_TEST_PASSED_COUNT=$(($SERIALIZE_TEST_PASSED_COUNT-1))
 read -p "Press [Enter] to continue testing... (enter)"
 time ./test_xml_b64 || SERIALIZE_TEST_PASSED_COUNT=$(($SERIALIZE_TEST_PASSED_COUNT-1))
+read -p "Press [Enter] to continue testing... (enter)"
+time ./test_metrics || SERIALIZE_TEST_PASSED_COUNT=$(($SERIALIZE_TEST_PASSED_COUNT-1))
 
-if [ "$SERIALIZE_TEST_PASSED_COUNT" -eq "3" ]; then
-    echo "[test_daemon] All tests cases (test_binary, test_xml, test_xml_b64) passed"
+if [ "$SERIALIZE_TEST_PASSED_COUNT" -eq "4" ]; then
+    echo "[test_daemon] All tests cases (test_binary, test_xml, test_xml_b64, test_metrics) passed"
     exit 0
 else
     echo "[test_daemon] Only $SERIALIZE_TEST_PASSED_COUNT tests passed, check logs for more information"
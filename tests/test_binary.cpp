@@ -1,16 +1,34 @@
+#include "async_writer.h"
+#include "binary_async.h"
+#include "binary_checkpoint.h"
+#include "binary_columnar.h"
+#include "binary_diff.h"
+#include "binary_dictionary.h"
+#include "binary_flat.h"
+#include "binary_packed.h"
+#include "binary_sharded.h"
+#include "binary_strings.h"
+#include "fingerprint.h"
 #include "libbinary.h"
 #include "test_utils.h"
 
+#include <bitset>
+#include <filesystem>
 #include <iostream>
 #include <iomanip>
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <vector>
 #include <list>
 #include <map>
+#include <memory>
 #include <unordered_map>
 #include <set>
 #include <tuple>
+#include <atomic>
+#include <thread>
+#include <future>
 
 using std::string;
 using std::vector;
@@ -24,6 +42,9 @@ using std::cout;
 using std::endl;
 
 using namespace serializer::binary;
+using serializer::DecodeErrc;
+using serializer::DecodeLimits;
+using serializer::DecodeResult;
 
 struct _SimpleStruct : BinSerializable {
   _SimpleStruct() {}
@@ -71,6 +92,28 @@ struct UserDefinedType : BinSerializable {
   }
 };
 
+// fails both ways, like a user type rejecting its input
+struct ThrowingType : BinSerializable {
+  string serializeToString() const override { throw std::runtime_error("ThrowingType::serializeToString"); }
+  void deserializeFromString(const string&) override { throw std::runtime_error("ThrowingType::deserializeFromString"); }
+};
+
+struct GraphNode : BinSerializable {
+  int id = 0;
+  vector<std::shared_ptr<GraphNode>> children;
+  string serializeToString() const override {
+    std::stringstream ss;
+    ::serialize(id, ss);
+    ::serialize(children, ss);
+    return ss.str();
+  }
+  void deserializeFromString(const string& s) override {
+    std::stringstream ss(s);
+    ::deserialize(id, ss);
+    ::deserialize(children, ss);
+  }
+};
+
 string serializeMyStruct(const UserDefinedType& udt) {
   std::stringstream ss;
   serialize(udt.idx, ss);
@@ -301,6 +344,737 @@ int main() {
   deserialize(const_cstr2, "result/const_cstr.bin");
   EXPECT_EQ(string(const_cstr1), string(const_cstr2), "const char*");
 
+  // bounded decoding of untrusted input
+  DecodeLimits limits;
+  vector<string> bounded_vec1 = {"a", "bb", "ccc"};
+  serialize(bounded_vec1, "result/bounded_vector.bin");
+  vector<string> bounded_vec2;
+  deserialize(bounded_vec2, "result/bounded_vector.bin", limits);
+  EXPECT_EQ(bounded_vec1.size(), bounded_vec2.size(), "bounded vector.size()");
+  EXPECT_EQ(bounded_vec1[2], bounded_vec2[2], "bounded vector[2]");
+  {
+    // overwrite the length prefix of the vector with a huge value
+    std::stringstream ss;
+    serialize(bounded_vec1, ss);
+    string corrupted = ss.str();
+    const size_t huge = size_t(1) << 40;
+    memcpy(&corrupted[sizeof(size_t)], &huge, sizeof(huge));
+    std::stringstream corrupted_ss(corrupted);
+    try {
+      deserialize(bounded_vec2, corrupted_ss, limits);
+      EXPECT_EQ(1, 0, "deserialize with a corrupted container length should throw an exception");
+    } catch (const std::exception &e) {
+      cout << "PASSED (XFAIL) corrupted container length rejected before allocating." << endl;
+    }
+  }
+  {
+    // a length that fits the limits, but not the remaining input
+    std::stringstream ss;
+    serialize(string(100, 'x'), ss);
+    string truncated = ss.str().substr(0, 50);
+    std::stringstream truncated_ss(truncated);
+    string s;
+    try {
+      deserialize(s, truncated_ss, limits);
+      EXPECT_EQ(1, 0, "deserialize of a truncated string should throw an exception");
+    } catch (const std::exception &e) {
+      cout << "PASSED (XFAIL) string longer than the remaining input rejected." << endl;
+    }
+  }
+  {
+    DecodeLimits shallow;
+    shallow.max_depth = 2;
+    vector<vector<vector<int>>> deep1 = {{{1}}};
+    std::stringstream ss;
+    serialize(deep1, ss);
+    vector<vector<vector<int>>> deep2;
+    try {
+      deserialize(deep2, ss, shallow);
+      EXPECT_EQ(1, 0, "deserialize deeper than max_depth should throw an exception");
+    } catch (const std::exception &e) {
+      cout << "PASSED (XFAIL) nesting deeper than max_depth rejected." << endl;
+    }
+  }
+  {
+    DecodeLimits small;
+    small.max_total_allocation = 64;
+    vector<double> doubles1(100, 1.0);
+    std::stringstream ss;
+    serialize(doubles1, ss);
+    vector<double> doubles2;
+    try {
+      deserialize(doubles2, ss, small);
+      EXPECT_EQ(1, 0, "deserialize beyond max_total_allocation should throw an exception");
+    } catch (const std::exception &e) {
+      cout << "PASSED (XFAIL) allocation beyond max_total_allocation rejected." << endl;
+    }
+  }
+
+  // exception-free decoding
+  {
+    vector<vector<int>> nested1 = {{1, 2}, {3}};
+    std::stringstream ss;
+    serialize(nested1, ss);
+    vector<vector<int>> nested2;
+    std::stringstream ok_ss(ss.str());
+    DecodeResult r = try_deserialize(nested2, ok_ss);
+    EXPECT_EQ((int)r.code, (int)DecodeErrc::ok, "try_deserialize");
+    EXPECT_EQ(nested2[1][0], 3, "try_deserialize nested[1][0]");
+    // cut the input in the middle of the last int
+    std::stringstream truncated_ss(ss.str().substr(0, ss.str().size() - 3));
+    r = try_deserialize(nested2, truncated_ss);
+    EXPECT_EQ((int)r.code, (int)DecodeErrc::truncated, "try_deserialize truncated");
+    EXPECT_EQ(r.offset, ss.str().size() - sizeof(size_t) - sizeof(int), "try_deserialize truncated offset");
+    r = try_deserialize(nested2, "result/non_existing_file.bin");
+    EXPECT_EQ((int)r.code, (int)DecodeErrc::open_failed, "try_deserialize non-existing file");
+  }
+
+  // columnar encoding
+  {
+    vector<tuple<int, double, string>> rows1 = {{1, 1.5, "a"}, {2, 2.5, "bb"}, {3, 3.5, "ccc"}};
+    serialize_columnar(rows1, "result/columnar.bin");
+    vector<tuple<int, double, string>> rows2;
+    deserialize_columnar(rows2, "result/columnar.bin");
+    EXPECT_EQ(rows1.size(), rows2.size(), "columnar size");
+    EXPECT_EQ(std::get<0>(rows1[2]), std::get<0>(rows2[2]), "columnar std::get<0>(rows[2])");
+    EXPECT_EQ(std::get<1>(rows1[1]), std::get<1>(rows2[1]), "columnar std::get<1>(rows[1])");
+    EXPECT_EQ(std::get<2>(rows1[2]), std::get<2>(rows2[2]), "columnar std::get<2>(rows[2])");
+    // read single columns, skipping the others
+    vector<double> doubles;
+    deserialize_column(doubles, 1, "result/columnar.bin");
+    EXPECT_EQ(doubles.size(), rows1.size(), "column 1 size");
+    EXPECT_EQ(doubles[2], 3.5, "column 1 [2]");
+    vector<string> strings;
+    deserialize_column(strings, 2, "result/columnar.bin");
+    EXPECT_EQ(strings[1], string("bb"), "column 2 [1]");
+
+    list<pair<string, int>> pairs1 = {{"x", 1}, {"y", 2}};
+    std::stringstream ss;
+    serialize_columnar(pairs1, ss);
+    list<pair<string, int>> pairs2;
+    deserialize_columnar(pairs2, ss);
+    EXPECT_EQ(pairs2.back().first, string("y"), "columnar list<pair>.back().first");
+    EXPECT_EQ(pairs2.back().second, 2, "columnar list<pair>.back().second");
+  }
+
+  // packed maps and sets
+  {
+    set<long long> ids1;
+    for (long long i = 0; i < 1000; i++) {
+      ids1.insert(1000000000000LL + 3 * i);
+    }
+    ids1.insert(-5);
+    std::stringstream ss;
+    serialize_packed(ids1, ss);
+    // one byte per delta, apart from the first two keys
+    EXPECT_EQ((ss.str().size() < 2 * sizeof(size_t) + 1000 + 20), true, "packed set<long long> size");
+    set<long long> ids2;
+    deserialize_packed(ids2, ss);
+    EXPECT_EQ((ids1 == ids2), true, "packed set<long long>");
+
+    map<int, double, std::greater<int>> m1 = {{-3, 0.5}, {7, 1.5}, {INT32_MAX, 2.5}, {INT32_MIN, 3.5}};
+    serialize_packed(m1, "result/packed.bin");
+    map<int, double, std::greater<int>> m2;
+    deserialize_packed(m2, "result/packed.bin");
+    EXPECT_EQ((m1 == m2), true, "packed map<int, double, greater>");
+
+    // steps across zero are as small as any other
+    std::stringstream across, positive;
+    serialize_packed(set<int>{-3, -2, -1, 0, 1, 2, 3}, across);
+    serialize_packed(set<int>{10, 11, 12, 13, 14, 15, 16}, positive);
+    EXPECT_EQ(across.str().size(), positive.str().size(), "packed set<int> across zero size");
+    set<int> across_set;
+    deserialize_packed(across_set, across);
+    EXPECT_EQ((across_set == set<int>{-3, -2, -1, 0, 1, 2, 3}), true, "packed set<int> across zero");
+
+    unordered_map<uint8_t, bool> um1 = {{200, true}, {3, false}, {255, true}};
+    std::stringstream ss2;
+    serialize_packed(um1, ss2);
+    unordered_map<uint8_t, bool> um2;
+    deserialize_packed(um2, ss2);
+    EXPECT_EQ((um1 == um2), true, "packed unordered_map<uint8_t, bool>");
+
+    set<double> d1 = {-1.5, 0.0, 3.25};
+    serialize_packed(d1, ss2);
+    set<double> d2;
+    deserialize_packed(d2, ss2);
+    EXPECT_EQ((d1 == d2), true, "packed set<double>");
+
+    // the count promises more keys than the block holds
+    string bytes = ss.str();
+    size_t count = 5000;
+    memcpy(&bytes[sizeof(size_t)], &count, sizeof(count));
+    std::stringstream bad(bytes);
+    try {
+      deserialize_packed(ids2, bad);
+      EXPECT_EQ(1, 0, "deserialize_packed with a corrupted count should throw an exception");
+    } catch (const std::exception &e) {
+      cout << "PASSED (XFAIL) packed keys block shorter than the count rejected." << endl;
+    }
+    // a count far beyond the block fails before anything is allocated for it
+    count = size_t(1) << 60;
+    memcpy(&bytes[sizeof(size_t)], &count, sizeof(count));
+    std::stringstream huge(bytes);
+    try {
+      deserialize_packed(ids2, huge);
+      EXPECT_EQ(1, 0, "deserialize_packed with a huge count should throw an exception");
+    } catch (const std::exception &e) {
+      EXPECT_EQ((string(e.what()).find("truncated") != string::npos), true, "packed count beyond the keys block");
+    }
+  }
+
+  // bit-packed vector<bool> and bitset
+  {
+    vector<bool> mask1(1000);
+    for (size_t i = 0; i < mask1.size(); i++) {
+      mask1[i] = i % 3 == 0 || i % 7 == 0;
+    }
+    std::stringstream ss;
+    serialize(mask1, ss);
+    EXPECT_EQ(ss.str().size(), 2 * sizeof(size_t) + 16 * sizeof(uint64_t), "vector<bool> packed size");
+    vector<bool> mask2 = {true, true};
+    deserialize(mask2, ss);
+    EXPECT_EQ((mask1 == mask2), true, "vector<bool> packed");
+
+    std::bitset<130> bits1;
+    bits1.set(0).set(64).set(129);
+    serialize(bits1, "result/bitset.bin");
+    std::bitset<130> bits2;
+    deserialize(bits2, "result/bitset.bin");
+    EXPECT_EQ((bits1 == bits2), true, "bitset<130>");
+    std::bitset<64> bits3;
+    DecodeResult r = try_deserialize(bits3, "result/bitset.bin");
+    EXPECT_EQ((int)r.code, (int)DecodeErrc::size_mismatch, "bitset of a different size");
+
+    vector<vector<bool>> masks1 = {{}, {false}, vector<bool>(65, true)};
+    serialize(masks1, ss);
+    vector<vector<bool>> masks2;
+    deserialize(masks2, ss);
+    EXPECT_EQ((masks1 == masks2), true, "vector<vector<bool>>");
+  }
+
+  // dictionary-encoded strings
+  {
+    vector<string> words1;
+    for (int i = 0; i < 300; i++) {
+      words1.push_back(i % 3 == 0 ? "alpha" : (i % 3 == 1 ? "beta" : string("gamma\0delta", 11)));
+    }
+    std::stringstream plain, ss;
+    serialize(words1, plain);
+    serialize_dictionary(words1, ss);
+    EXPECT_EQ((ss.str().size() < plain.str().size() / 10), true, "dictionary vector<string> size");
+    vector<string> words2;
+    deserialize_dictionary(words2, ss);
+    EXPECT_EQ((words1 == words2), true, "dictionary vector<string>");
+
+    map<string, int> counts1 = {{"x", 1}, {"y", 2}, {"z", 3}};
+    map<int, string> names1 = {{1, "red"}, {2, "green"}, {3, "red"}};
+    serialize_dictionary(counts1, "result/dictionary.bin");
+    serialize_dictionary(names1, ss);
+    map<string, int> counts2;
+    deserialize_dictionary(counts2, "result/dictionary.bin");
+    EXPECT_EQ((counts1 == counts2), true, "dictionary map<string, int>");
+
+    // interned loading: every occurrence of a value shares one string
+    InternPool pool;
+    std::stringstream ss2(ss.str());
+    list<std::string_view> views;
+    deserialize_dictionary(views, ss2, pool);
+    map<int, std::string_view> names2;
+    deserialize_dictionary(names2, ss2, pool);
+    EXPECT_EQ(views.size(), words1.size(), "interned list<string_view> size");
+    EXPECT_EQ(views.back(), std::string_view(words1.back()), "interned list<string_view>.back()");
+    EXPECT_EQ((views.front().data() == std::next(views.begin(), 3)->data()), true, "interned views share storage");
+    EXPECT_EQ((names2[1].data() == names2[3].data()), true, "interned map values share storage");
+    EXPECT_EQ(names2[2], std::string_view("green"), "interned map<int, string_view>");
+    EXPECT_EQ(pool.size(), (size_t)5, "intern pool size");
+
+    // an id past the end of the dictionary
+    std::stringstream one;
+    serialize_dictionary(vector<string>{"a"}, one);
+    string corrupted = one.str();
+    corrupted.back() = 5;
+    std::stringstream bad(corrupted);
+    try {
+      deserialize_dictionary(words2, bad);
+      EXPECT_EQ(1, 0, "deserialize_dictionary with an unknown id should throw an exception");
+    } catch (const std::exception &e) {
+      cout << "PASSED (XFAIL) dictionary id out of range rejected." << endl;
+    }
+    // huge counts of strings and of elements fail before anything is allocated for them
+    size_t huge_count = size_t(1) << 60;
+    for (size_t at : {size_t(0), one.str().size() - 1 - 2 * sizeof(size_t)}) {
+      corrupted = one.str();
+      memcpy(&corrupted[at], &huge_count, sizeof(huge_count));
+      std::stringstream huge(corrupted);
+      try {
+        deserialize_dictionary(words2, huge);
+        EXPECT_EQ(1, 0, "deserialize_dictionary with a huge count should throw an exception");
+      } catch (const std::bad_alloc &e) {
+        EXPECT_EQ(1, 0, "deserialize_dictionary with a huge count should not allocate for it");
+      } catch (const std::exception &e) {
+        cout << "PASSED (XFAIL) dictionary count beyond the input rejected." << endl;
+      }
+    }
+  }
+
+  // lengths-then-blob string arrays
+  {
+    vector<string> tokens1 = {"the", "", "quick", string(300, 'b'), string("n\0l", 3)};
+    std::stringstream plain, ss;
+    serialize(tokens1, plain);
+    serialize_string_array(tokens1, ss);
+    EXPECT_EQ((ss.str().size() < plain.str().size()), true, "string array size");
+    list<string> tokens2;
+    deserialize_string_array(tokens2, ss);
+    EXPECT_EQ((vector<string>(tokens2.begin(), tokens2.end()) == tokens1), true, "string array list<string>");
+
+    serialize_string_array(tokens1, "result/string_array.bin");
+    string blob;
+    vector<std::string_view> views;
+    deserialize_string_array(views, blob, "result/string_array.bin");
+    EXPECT_EQ(views.size(), tokens1.size(), "string array views size");
+    EXPECT_EQ(views[3], std::string_view(tokens1[3]), "string array views[3]");
+    EXPECT_EQ(views[4], std::string_view(tokens1[4]), "string array views[4]");
+    EXPECT_EQ((views[2].data() == blob.data() + 3), true, "string array views point into the blob");
+
+    // the lengths add up to more than the blob
+    string corrupted = ss.str();
+    corrupted[3 * sizeof(size_t)] = 100;
+    std::stringstream bad(corrupted);
+    try {
+      deserialize_string_array(tokens2, bad);
+      EXPECT_EQ(1, 0, "deserialize_string_array with corrupted lengths should throw an exception");
+    } catch (const std::exception &e) {
+      cout << "PASSED (XFAIL) string array lengths past the blob rejected." << endl;
+    }
+    // a count far beyond the lengths block fails before anything is allocated for it
+    corrupted = ss.str();
+    size_t count = size_t(1) << 60;
+    memcpy(&corrupted[0], &count, sizeof(count));
+    std::stringstream huge(corrupted);
+    try {
+      deserialize_string_array(tokens2, huge);
+      EXPECT_EQ(1, 0, "deserialize_string_array with a huge count should throw an exception");
+    } catch (const std::exception &e) {
+      EXPECT_EQ((string(e.what()).find("size prefix") != string::npos), true, "string array count beyond the lengths");
+    }
+  }
+
+  // shared_ptr graphs and unique_ptr
+  {
+    // a diamond: root -> a, b -> shared, with a cycle from shared back to root
+    auto root = std::make_shared<GraphNode>();
+    auto a = std::make_shared<GraphNode>();
+    auto b = std::make_shared<GraphNode>();
+    auto shared = std::make_shared<GraphNode>();
+    root->id = 1, a->id = 2, b->id = 3, shared->id = 4;
+    root->children = {a, b};
+    a->children = {shared};
+    b->children = {shared};
+    shared->children = {root};
+    serialize(root, "result/graph.bin");
+    std::shared_ptr<GraphNode> root2;
+    deserialize(root2, "result/graph.bin");
+    EXPECT_EQ(root2->children.size(), (size_t)2, "graph root children");
+    const auto &shared2 = root2->children[0]->children[0];
+    EXPECT_EQ(shared2->id, 4, "graph shared node id");
+    EXPECT_EQ((shared2 == root2->children[1]->children[0]), true, "graph sharing preserved");
+    EXPECT_EQ((shared2->children[0] == root2), true, "graph cycle preserved");
+    // break the cycles, so that the graphs are freed
+    shared->children.clear();
+    shared2->children.clear();
+
+    int x = 42;
+    vector<std::shared_ptr<int>> ptrs1 = {std::make_shared<int>(x), nullptr};
+    ptrs1.push_back(ptrs1[0]);
+    std::stringstream ss;
+    serialize(ptrs1, ss);
+    vector<std::shared_ptr<int>> ptrs2;
+    deserialize(ptrs2, ss);
+    EXPECT_EQ(*ptrs2[0], 42, "vector<shared_ptr<int>>[0]");
+    EXPECT_EQ((ptrs2[1] == nullptr), true, "vector<shared_ptr<int>>[1] is null");
+    EXPECT_EQ((ptrs2[2] == ptrs2[0]), true, "vector<shared_ptr<int>> aliasing preserved");
+
+    pair<std::unique_ptr<string>, std::unique_ptr<int>> owned1 = {std::make_unique<string>("owned"), nullptr};
+    serialize(owned1, ss);
+    pair<std::unique_ptr<string>, std::unique_ptr<int>> owned2;
+    deserialize(owned2, ss);
+    EXPECT_EQ(*owned2.first, string("owned"), "unique_ptr<string>");
+    EXPECT_EQ((owned2.second == nullptr), true, "null unique_ptr<int>");
+
+    // a back-reference to an object that was never written
+    std::stringstream bad;
+    serialize(size_t(7), bad);
+    std::shared_ptr<int> dangling;
+    DecodeResult r = try_deserialize(dangling, bad);
+    EXPECT_EQ((int)r.code, (int)DecodeErrc::size_mismatch, "dangling back-reference");
+  }
+
+  // type fingerprints
+  {
+    using serializer::type_fingerprint_v;
+    static_assert(type_fingerprint_v<vector<int>> == type_fingerprint_v<const list<int>>);
+    static_assert(type_fingerprint_v<vector<int>> != type_fingerprint_v<vector<unsigned>>);
+    static_assert(type_fingerprint_v<vector<int>> != type_fingerprint_v<vector<long long>>);
+    static_assert(type_fingerprint_v<pair<int, string>> != type_fingerprint_v<pair<string, int>>);
+    static_assert(type_fingerprint_v<pair<int, int>> != type_fingerprint_v<tuple<int, int>>);
+    static_assert(type_fingerprint_v<map<int, int>> != type_fingerprint_v<vector<pair<int, int>>>);
+
+    map<string, vector<double>> series1 = {{"a", {1.0, 2.0}}, {"b", {}}};
+    serialize_with_fingerprint(series1, "result/fingerprint.bin");
+    map<string, vector<double>> series2;
+    deserialize_with_fingerprint(series2, "result/fingerprint.bin");
+    EXPECT_EQ((series1 == series2), true, "deserialize_with_fingerprint");
+    std::ifstream is("result/fingerprint.bin", std::ios::binary);
+    uint64_t fingerprint = 0;
+    const bool read_ok = (bool)read_fingerprint(fingerprint, is);
+    EXPECT_EQ(read_ok, true, "read_fingerprint");
+    EXPECT_EQ(fingerprint, (type_fingerprint_v<map<string, vector<double>>>), "read_fingerprint value");
+
+    map<string, vector<float>> wrong;
+    DecodeResult r = try_deserialize_with_fingerprint(wrong, "result/fingerprint.bin");
+    EXPECT_EQ((int)r.code, (int)DecodeErrc::fingerprint_mismatch, "fingerprint mismatch");
+    EXPECT_EQ(wrong.size(), (size_t)0, "nothing decoded on fingerprint mismatch");
+  }
+
+  // background writer
+  {
+    std::atomic<int> written{0};
+    std::atomic<int> failed{0};
+    auto done = [&](const string &, bool ok) { (ok ? written : failed)++; };
+    {
+      // a tiny queue, so that producers have to wait for room
+      AsyncWriter writer(4, 3);
+      vector<std::thread> producers;
+      for (int p = 0; p < 4; p++) {
+        producers.emplace_back([&, p] {
+          for (int i = 0; i < 20; i++) {
+            const string file_name = "result/async_" + std::to_string(p) + "_" + std::to_string(i) + ".bin";
+            if (i % 2 == 0) {
+              writer.save(file_name, vector<int>{p, i}, done);
+            } else {
+              std::stringstream ss;
+              serialize(vector<int>{p, i}, ss);
+              writer.write(file_name, ss.str(), done);
+            }
+          }
+        });
+      }
+      for (auto &t : producers) {
+        t.join();
+      }
+      writer.flush();
+      EXPECT_EQ(written.load(), 80, "AsyncWriter jobs written after flush");
+      writer.save("result/no_such_dir/async.bin", 1, done);
+      // neither a throwing encoder nor a throwing callback stops the writer
+      writer.save("result/async_throwing.bin", ThrowingType(), done);
+      writer.write("result/async_callback.bin", "", [](const string &, bool) { throw std::runtime_error("done"); });
+    }
+    EXPECT_EQ(failed.load(), 2, "AsyncWriter reports failures, and drains on destruction");
+    vector<int> v;
+    deserialize(v, "result/async_3_7.bin");
+    EXPECT_EQ((v == vector<int>{3, 7}), true, "AsyncWriter pre-encoded buffer");
+    deserialize(v, "result/async_2_18.bin");
+    EXPECT_EQ((v == vector<int>{2, 18}), true, "AsyncWriter saved object");
+  }
+
+  // asynchronous entry points on the library's thread pool
+  {
+    EXPECT_EQ(serializer::set_thread_pool_size(3), true, "set_thread_pool_size before first use");
+    vector<vector<int>> states1(12);
+    for (size_t i = 0; i < states1.size(); i++) {
+      states1[i] = vector<int>(1000, (int)i);
+    }
+    vector<std::future<void>> futures;
+    for (size_t i = 0; i < states1.size(); i++) {
+      futures.push_back(serialize_async(states1[i], "result/state_" + std::to_string(i) + ".bin"));
+    }
+    for (auto &f : futures) {
+      f.get();
+    }
+    futures.clear();
+    vector<vector<int>> states2(states1.size());
+    for (size_t i = 0; i < states2.size(); i++) {
+      futures.push_back(deserialize_async(states2[i], "result/state_" + std::to_string(i) + ".bin"));
+    }
+    for (auto &f : futures) {
+      f.get();
+    }
+    EXPECT_EQ((states1 == states2), true, "deserialize_async");
+    EXPECT_EQ(serializer::thread_pool().size(), (size_t)3, "thread pool size");
+    EXPECT_EQ(serializer::set_thread_pool_size(4), false, "set_thread_pool_size after first use");
+
+    vector<int> missing;
+    std::future<void> f = deserialize_async(missing, "result/non_existing_file.bin");
+    try {
+      f.get();
+      EXPECT_EQ(1, 0, "deserialize_async of a missing file should throw from get()");
+    } catch (const std::exception &e) {
+      cout << "PASSED (XFAIL) deserialize_async rethrows from get()." << endl;
+    }
+    std::promise<DecodeResult> done;
+    deserialize_async(missing, "result/non_existing_file.bin", [&](DecodeResult r) { done.set_value(r); });
+    const DecodeResult r = done.get_future().get();
+    EXPECT_EQ((int)r.code, (int)DecodeErrc::open_failed, "deserialize_async callback");
+
+    // a throwing user type, or callback, does not take the pool down
+    serialize(string("x"), "result/async_throwing.bin");
+    ThrowingType throwing;
+    std::promise<DecodeResult> thrown;
+    deserialize_async(throwing, "result/async_throwing.bin", [&](DecodeResult r) { thrown.set_value(r); });
+    const DecodeErrc thrown_code = thrown.get_future().get().code;
+    EXPECT_EQ((int)thrown_code, (int)DecodeErrc::exception_thrown, "deserialize_async exception");
+    deserialize_async(missing, "result/non_existing_file.bin", [](DecodeResult) { throw std::runtime_error("done"); });
+    f = deserialize_async(states2[0], "result/state_0.bin");
+    f.get();
+    EXPECT_EQ((states2[0] == states1[0]), true, "thread pool survives a throwing callback");
+  }
+
+  // sharded maps and sets
+  {
+    unordered_map<int, string> big1;
+    for (int i = 0; i < 1000; i++) {
+      big1[i * 7] = std::to_string(i);
+    }
+    serialize_sharded(big1, "result/sharded", 4);
+    unordered_map<int, string> big2 = {{-1, "stale"}};
+    deserialize_sharded(big2, "result/sharded");
+    EXPECT_EQ((big1 == big2), true, "sharded unordered_map");
+    // every shard is a regular map file
+    unordered_map<int, string> shard;
+    deserialize(shard, "result/sharded.2");
+    EXPECT_EQ((shard.size() > 0 && shard.size() < big1.size()), true, "single shard");
+    EXPECT_EQ(big1[shard.begin()->first], shard.begin()->second, "single shard element");
+
+    map<int, int> wrong;
+    DecodeResult r = try_deserialize_sharded(wrong, "result/sharded");
+    EXPECT_EQ((int)r.code, (int)DecodeErrc::fingerprint_mismatch, "sharded fingerprint mismatch");
+
+    set<string> names1 = {"a", "b", "c", "d", "e"};
+    serialize_sharded(names1, "result/sharded_set", 3);
+    set<string> names2;
+    deserialize_sharded(names2, "result/sharded_set");
+    EXPECT_EQ((names1 == names2), true, "sharded set");
+  }
+
+  // incremental checkpoints
+  {
+    TrackedMap<map<int, string>> tracked;
+    Checkpointer<map<int, string>> checkpointer("result/checkpoint", 4);
+    // drops whatever a previous run left behind
+    checkpointer.consolidate(tracked);
+    for (int i = 0; i < 100; i++) {
+      tracked.insert_or_assign(i, std::to_string(i));
+    }
+    checkpointer.checkpoint(tracked);
+    EXPECT_EQ(tracked.changes().size(), (size_t)0, "checkpoint clears changes");
+    tracked.mutate(5) += "!";
+    tracked.erase(7);
+    tracked.erase(1000);
+    tracked.insert_or_assign(200, "new");
+    EXPECT_EQ(tracked.changes().size(), (size_t)3, "tracked changes");
+    checkpointer.checkpoint(tracked);
+    EXPECT_EQ(std::filesystem::exists(checkpointer.delta_file_name(2)), true, "delta written");
+    tracked.insert_or_assign(7, "back");
+    tracked.erase(200);
+    checkpointer.checkpoint(tracked);
+
+    map<int, string> restored = {{-1, "stale"}};
+    restore_checkpoint(restored, "result/checkpoint");
+    EXPECT_EQ((restored == tracked.data()), true, "restore base and deltas");
+
+    // a new checkpointer resumes after the 3 deltas, so its checkpoint is a new base
+    Checkpointer<map<int, string>> resumed("result/checkpoint", 4);
+    tracked.erase(0);
+    resumed.checkpoint(tracked);
+    EXPECT_EQ(std::filesystem::exists(checkpointer.delta_file_name(3)), false, "consolidation removes deltas");
+    restored.clear();
+    restore_checkpoint(restored, "result/checkpoint");
+    EXPECT_EQ((restored == tracked.data()), true, "restore consolidated base");
+
+    TrackedMap<unordered_map<string, int>> counts;
+    Checkpointer<unordered_map<string, int>> counts_checkpointer("result/checkpoint_counts");
+    counts_checkpointer.consolidate(counts);
+    counts.mutate("a")++;
+    counts.mutate("b") += 2;
+    counts_checkpointer.checkpoint(counts);
+    counts.mutate("a")++;
+    counts_checkpointer.checkpoint(counts);
+    unordered_map<string, int> counts_restored;
+    restore_checkpoint(counts_restored, "result/checkpoint_counts");
+    EXPECT_EQ((counts_restored == counts.data()), true, "restore unordered_map");
+
+    const DecodeResult r = try_restore_checkpoint(counts_restored, "result/no_checkpoint");
+    EXPECT_EQ((int)r.code, (int)DecodeErrc::open_failed, "restore missing checkpoint");
+
+    // sharing within a delta survives the restore
+    using SharedPairs = map<int, pair<std::shared_ptr<int>, std::shared_ptr<int>>>;
+    TrackedMap<SharedPairs> shared;
+    Checkpointer<SharedPairs> shared_checkpointer("result/checkpoint_shared");
+    auto a = std::make_shared<int>(1), b = std::make_shared<int>(2);
+    shared.insert_or_assign(1, {a, a});
+    shared_checkpointer.consolidate(shared);
+    shared.insert_or_assign(1, {a, a});
+    shared.insert_or_assign(2, {b, b});
+    shared_checkpointer.checkpoint(shared);
+    SharedPairs shared_restored;
+    restore_checkpoint(shared_restored, "result/checkpoint_shared");
+    EXPECT_EQ(*shared_restored.at(2).first, 2, "restore shared_ptr from delta");
+    EXPECT_EQ(*shared_restored.at(2).second, 2, "restore repeated shared_ptr from delta");
+    EXPECT_EQ((shared_restored.at(2).first == shared_restored.at(2).second), true, "delta keeps sharing");
+  }
+
+  // structural patches
+  {
+    using Config = tuple<map<string, vector<int>>, set<string>, list<pair<int, string>>, string>;
+    Config v1;
+    for (int i = 0; i < 100; i++) {
+      std::get<0>(v1)["key" + std::to_string(i)] = vector<int>(50, i);
+    }
+    std::get<1>(v1) = {"a", "b", "c"};
+    std::get<2>(v1) = {{1, "one"}, {2, "two"}, {3, "three"}};
+    std::get<3>(v1) = "version 1";
+    Config v2 = v1;
+    std::get<0>(v2)["key5"][7] = -1;
+    std::get<0>(v2).erase("key6");
+    std::get<0>(v2)["new"] = {1, 2, 3};
+    std::get<0>(v2)["key8"].push_back(42);
+    std::get<1>(v2).erase("b");
+    std::get<1>(v2).insert("d");
+    std::get<2>(v2).back().second = "THREE";
+    std::get<2>(v2).pop_front();
+
+    std::stringstream patch;
+    serialize_patch(v1, v2, patch);
+    std::stringstream full;
+    serialize(v2, full);
+    EXPECT_EQ((patch.str().size() * 10 < full.str().size()), true, "patch is smaller than the object");
+    Config patched = v1;
+    apply_patch(patched, patch);
+    EXPECT_EQ((patched == v2), true, "apply_patch");
+
+    std::stringstream empty_patch;
+    serialize_patch(v2, v2, empty_patch);
+    EXPECT_EQ(empty_patch.str().size(), 3 * sizeof(size_t) + sizeof(uint64_t), "patch of an unchanged object");
+
+    unordered_map<int, std::unique_ptr<string>> ptrs1;
+    ptrs1[1] = std::make_unique<string>("x");
+    ptrs1[2] = std::make_unique<string>("y");
+    unordered_map<int, std::unique_ptr<string>> ptrs2;
+    ptrs2[1] = std::make_unique<string>("x");
+    ptrs2[2] = nullptr;
+    serialize_patch(ptrs1, ptrs2, "result/patch.bin");
+    apply_patch(ptrs1, "result/patch.bin");
+    EXPECT_EQ((*ptrs1[1] == "x" && ptrs1[2] == nullptr), true, "apply_patch to unique_ptrs");
+
+    vector<int> wrong;
+    DecodeResult r = try_apply_patch(wrong, "result/patch.bin");
+    EXPECT_EQ((int)r.code, (int)DecodeErrc::fingerprint_mismatch, "patch fingerprint mismatch");
+    vector<int> shorter = {1, 2, 3};
+    vector<int> longer = {1, 2, 3, 4, 5};
+    serialize_patch(longer, shorter, "result/patch.bin");
+    vector<int> other = longer;
+    apply_patch(other, "result/patch.bin");
+    EXPECT_EQ((other == shorter), true, "shrinking patch");
+    serialize_patch(shorter, vector<int>{1, 9, 3}, "result/patch.bin");
+    r = try_apply_patch(other, "result/patch.bin");
+    EXPECT_EQ((int)r.code, (int)DecodeErrc::ok, "element patch");
+    other = {1};
+    r = try_apply_patch(other, "result/patch.bin");
+    EXPECT_EQ((int)r.code, (int)DecodeErrc::patch_mismatch, "patch of a missing element");
+
+    // a patch that claims to grow an array far beyond its input
+    std::stringstream grow;
+    serialize_patch(vector<int>{}, vector<int>(77, 1), grow);
+    string bogus = grow.str();
+    const uint64_t new_size = 77, huge_size = uint64_t(1) << 40;
+    const size_t size_pos = bogus.find(string(reinterpret_cast<const char*>(&new_size), sizeof(new_size)));
+    bogus.replace(size_pos, sizeof(huge_size), reinterpret_cast<const char*>(&huge_size), sizeof(huge_size));
+    std::stringstream bogus_is(bogus);
+    other.clear();
+    r = try_apply_patch(other, bogus_is);
+    EXPECT_EQ((int)r.code, (int)DecodeErrc::truncated, "patch growing past its input");
+    {
+      serializer::DecodeScope scope(serializer::DecodeLimits{});
+      std::stringstream limited_is(bogus);
+      other.clear();
+      r = try_apply_patch(other, limited_is);
+      EXPECT_EQ((int)r.code, (int)DecodeErrc::container_too_long, "patch growing past its input, with limits");
+      std::stringstream grow_is(grow.str());
+      other.clear();
+      r = try_apply_patch(other, grow_is);
+      EXPECT_EQ((other == vector<int>(77, 1)), true, "growing patch with limits");
+    }
+  }
+
+  // flat layout
+  {
+    using Table = tuple<vector<double>, vector<string>, vector<vector<int>>, pair<string, int64_t>, list<int>>;
+    Table table;
+    for (int i = 0; i < 1000; i++) {
+      std::get<0>(table).push_back(i * 0.5);
+    }
+    std::get<1>(table) = {"alpha", "", "gamma"};
+    std::get<2>(table) = {{1, 2, 3}, {}, {4}};
+    std::get<3>(table) = {"name", -7};
+    std::get<4>(table) = {9, 8};
+    serialize_flat(table, "result/flat.bin");
+
+    FlatFile file;
+    DecodeResult r = file.open("result/flat.bin", true);
+    EXPECT_EQ((int)r.code, (int)DecodeErrc::ok, "open flat file");
+    FlatView<Table> root = file.root<Table>();
+    FlatView<vector<double>> doubles = root.get<0>();
+    EXPECT_EQ(doubles.size(), (size_t)1000, "flat vector size");
+    EXPECT_EQ(doubles[999], 499.5, "flat vector element");
+    EXPECT_EQ((reinterpret_cast<uintptr_t>(doubles.data()) % 64), (uintptr_t)0, "flat vector alignment");
+    EXPECT_EQ(root.get<1>()[0], std::string_view("alpha"), "flat string");
+    EXPECT_EQ(root.get<1>()[1].size(), (size_t)0, "flat empty string");
+    EXPECT_EQ(root.get<2>()[2][0], 4, "flat nested vector");
+    EXPECT_EQ(root.get<2>()[1].size(), (size_t)0, "flat empty nested vector");
+    EXPECT_EQ(root.get<3>().get<0>(), std::string_view("name"), "flat pair string");
+    EXPECT_EQ(root.get<3>().get<1>(), (int64_t)-7, "flat pair integer");
+    EXPECT_EQ(root.get<4>()[1], 8, "flat list");
+
+    doubles.set(0, 42.0);
+    root.get<3>().set<1>(100);
+    file.flush();
+    file.close();
+    Table copy = table;
+    std::get<0>(copy)[0] = 42.0;
+    std::get<3>(copy).second = 100;
+    // in-place updates reach the file
+    FlatFile reopened;
+    reopened.open("result/flat.bin");
+    EXPECT_EQ(reopened.root<Table>().get<0>()[0], 42.0, "flat in-place update");
+    EXPECT_EQ(reopened.root<Table>().get<3>().get<1>(), (int64_t)100, "flat in-place tuple update");
+    std::stringstream rewritten;
+    serialize_flat(copy, rewritten);
+    std::ifstream updated("result/flat.bin", std::ios::binary);
+    std::stringstream updated_bytes;
+    updated_bytes << updated.rdbuf();
+    EXPECT_EQ((updated_bytes.str() == rewritten.str()), true, "flat updates match a rewrite");
+
+    FlatView<vector<double>> wrong_root;
+    r = reopened.try_root<vector<double>>(wrong_root);
+    EXPECT_EQ((int)r.code, (int)DecodeErrc::fingerprint_mismatch, "flat fingerprint mismatch");
+    FlatFile missing;
+    r = missing.open("result/non_existing_file.bin");
+    EXPECT_EQ((int)r.code, (int)DecodeErrc::open_failed, "open missing flat file");
+
+    // a root offset past the end of the file
+    string corrupted = rewritten.str();
+    const uint64_t root_offset = corrupted.size();
+    memcpy(&corrupted[corrupted.size() - sizeof(root_offset)], &root_offset, sizeof(root_offset));
+    std::ofstream("result/flat_corrupted.bin", std::ios::binary) << corrupted;
+    FlatFile corrupted_file;
+    corrupted_file.open("result/flat_corrupted.bin");
+    FlatView<Table> bad_root;
+    r = corrupted_file.try_root<Table>(bad_root);
+    EXPECT_EQ((int)r.code, (int)DecodeErrc::truncated, "flat root offset out of range");
+  }
+
   SHOW_TEST_RESULT();
   TEST_QUIT();
 }
@@ -0,0 +1,101 @@
+// Built with enable_metrics defined as true, see CMakeLists.txt.
+#include "libbinary.h"
+#include "libxml.h"
+#include "test_utils.h"
+
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using std::map;
+using std::pair;
+using std::string;
+using std::vector;
+using std::cout;
+using std::endl;
+
+using serializer::metrics::Entry;
+using serializer::metrics::Op;
+
+using Nested = map<string, vector<pair<int, double>>>;
+
+// Returns the entries of op that recorded any call.
+vector<Entry> called(Op op) {
+  vector<Entry> result;
+  for (const Entry &e : serializer::metrics::snapshot()) {
+    if (e.op == op && e.calls != 0) {
+      result.push_back(e);
+    }
+  }
+  return result;
+}
+
+int main() {
+  const Nested nested1 = {{"a", {{1, 1.5}, {2, 2.5}}}, {"b", {}}, {"c", {{3, 3.5}}}};
+  const string type_name = serializer::metrics::demangle(typeid(Nested).name());
+
+  // binary: every element goes through serialize and deserialize again, but only the
+  // top-level calls are recorded
+  std::stringstream ss;
+  serializer::binary::serialize(nested1, ss);
+  Nested nested2;
+  serializer::binary::deserialize(nested2, ss);
+  EXPECT_EQ((nested1 == nested2), true, "binary round trip");
+  vector<Entry> out = called(Op::serialize);
+  EXPECT_EQ(out.size(), (size_t)1, "serialize entries");
+  if (out.size() == 1) {
+    EXPECT_EQ((out[0].type_name == type_name), true, "serialize type");
+    EXPECT_EQ(out[0].calls, (uint64_t)1, "serialize calls");
+    EXPECT_EQ(out[0].bytes_in, (uint64_t)0, "serialize bytes_in");
+    EXPECT_EQ(out[0].bytes_out, (uint64_t)ss.str().size(), "serialize bytes_out");
+  }
+  vector<Entry> in = called(Op::deserialize);
+  EXPECT_EQ(in.size(), (size_t)1, "deserialize entries");
+  if (in.size() == 1) {
+    EXPECT_EQ((in[0].type_name == type_name), true, "deserialize type");
+    EXPECT_EQ(in[0].calls, (uint64_t)1, "deserialize calls");
+    EXPECT_EQ(in[0].bytes_in, (uint64_t)ss.str().size(), "deserialize bytes_in");
+    EXPECT_EQ(in[0].bytes_out, (uint64_t)0, "deserialize bytes_out");
+  }
+
+  // xml files
+  serializer::xml::serialize_xml(nested1, "nested", "result/metrics.xml");
+  Nested nested3;
+  serializer::xml::deserialize_xml(nested3, "nested", "result/metrics.xml");
+  EXPECT_EQ((nested1 == nested3), true, "xml round trip");
+  const uint64_t file_size = std::filesystem::file_size("result/metrics.xml");
+  out = called(Op::serialize_xml);
+  EXPECT_EQ(out.size(), (size_t)1, "serialize_xml entries");
+  if (out.size() == 1) {
+    EXPECT_EQ(out[0].calls, (uint64_t)1, "serialize_xml calls");
+    EXPECT_EQ(out[0].bytes_out, file_size, "serialize_xml bytes_out");
+  }
+  in = called(Op::deserialize_xml);
+  EXPECT_EQ(in.size(), (size_t)1, "deserialize_xml entries");
+  if (in.size() == 1) {
+    EXPECT_EQ(in[0].calls, (uint64_t)1, "deserialize_xml calls");
+    EXPECT_EQ(in[0].bytes_in, file_size, "deserialize_xml bytes_in");
+  }
+
+  // reset keeps the entries, with every counter zeroed
+  serializer::metrics::reset();
+  const vector<Entry> entries = serializer::metrics::snapshot();
+  EXPECT_EQ(entries.empty(), false, "entries kept after reset");
+  bool zeroed = true;
+  for (const Entry &e : entries) {
+    uint64_t histogram = 0;
+    for (uint64_t h : e.histogram) {
+      histogram += h;
+    }
+    zeroed = zeroed && e.calls == 0 && e.bytes_in == 0 && e.bytes_out == 0 && e.total_ns == 0 &&
+             e.allocations == 0 && histogram == 0;
+  }
+  EXPECT_EQ(zeroed, true, "counters zeroed after reset");
+
+  SHOW_TEST_RESULT();
+  TEST_QUIT();
+}